@@ -1,6 +1,15 @@
 #pragma once
 #include "IDictionary.hpp"
+#include "async_implementation/completion_queue.hpp"
 #include <future>
+#include <stdexcept>
+
+/// Set on the future of an operation refused or dropped by an overloaded dictionary
+class overload_error : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
 
 class IAsyncReversedDictionary : public IReversedDictionaryBase
 {
@@ -11,3 +20,14 @@ public:
   virtual std::future<void>     insert(int document_id, gsl::span<const char*> text) = 0;
   virtual std::future<void>     remove(int document_id)                              = 0;
 };
+
+/// Asynchronous dictionary driven by rings instead of futures
+/// Requests are pushed to a submission ring and their completions posted, with their
+/// tag, to the completion queue of the client, which reaps them in batches.
+class IQueuedReversedDictionary : public IReversedDictionaryBase
+{
+public:
+  /// Queue r, its completion is posted to r.cq once done
+  /// Return false if the submission ring is full
+  virtual bool submit(const request_t& r) = 0;
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include "IDictionary.hpp"
+#include "async_implementation/completion_queue.hpp"
+#include "async_implementation/scheduler.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+
+/// Asynchronous dictionary for coroutines: co_await dic.search(word)
+/// The coroutine is suspended until the operation completes, then resumed by the
+/// Scheduler it runs on, or by the thread completing the operation if it has none.
+/// The operation lives in the frame of the awaiting coroutine, without a promise
+/// nor a future, and no thread blocks.
+class IAwaitableReversedDictionary : public IReversedDictionaryBase
+{
+public:
+  class operation
+  {
+  public:
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+      handle_    = h;
+      scheduler_ = Scheduler::current();
+      dic_->start(*this);
+    }
+
+    result_t await_resume() const { return result; }
+
+    /// Resume the awaiting coroutine, called once result is set
+    void complete()
+    {
+      if (scheduler_ != nullptr)
+        scheduler_->post(handle_);
+      else
+        handle_.resume();
+    }
+
+    request_t request;
+    result_t  result; // Empty for insert and remove
+
+  private:
+    friend IAwaitableReversedDictionary;
+
+    operation(IAwaitableReversedDictionary* dic, const request_t& r)
+      : request(r), dic_(dic)
+    {}
+
+    IAwaitableReversedDictionary* dic_;
+    std::coroutine_handle<>       handle_;
+    Scheduler*                    scheduler_ = nullptr;
+  };
+
+  /// Search the documents containing \p word in the database
+  operation search(const char* word) const
+  {
+    request_t r;
+    r.op   = request_t::search;
+    r.word = word;
+    // A search only reads the dictionary
+    return {const_cast<IAwaitableReversedDictionary*>(this), r};
+  }
+
+  /// Insert a new document in the database
+  operation insert(int document_id, gsl::span<const char*> text)
+  {
+    request_t r;
+    r.op          = request_t::insert;
+    r.document_id = document_id;
+    r.text        = text;
+    return {this, r};
+  }
+
+  /// Remove a document
+  operation remove(int document_id)
+  {
+    request_t r;
+    r.op          = request_t::remove;
+    r.document_id = document_id;
+    return {this, r};
+  }
+
+protected:
+  /// Run op.request, set op.result then call op.complete()
+  virtual void start(operation& op) = 0;
+};
+
+#endif
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <map>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <gsl/gsl-lite.hpp>
 
+#include "tokenizer.hpp"
+
 constexpr int MAX_RESULT_COUNT = 10;
 
 // Structure of a match
@@ -40,6 +48,43 @@ struct result_t
   match_t m_matched[MAX_RESULT_COUNT];
 };
 
+// Merge the matches of b into a, keeping the smallest document ids
+// a and b must not share any document, as the results of two shards
+inline void merge_results(result_t& a, const result_t& b)
+{
+  match_t all[2 * MAX_RESULT_COUNT];
+  auto last = std::copy(b.items().begin(), b.items().end(), std::copy(a.items().begin(), a.items().end(), all));
+  const int n = std::min(int(last - all), MAX_RESULT_COUNT);
+  std::partial_sort(all, all + n, last, [](match_t x, match_t y) { return x.id() < y.id(); });
+  std::copy_n(all, n, a.m_matched);
+  a.m_count = n;
+}
+
+// Id of a dictionary, unique in the process: unlike its address, never reused by another one
+// A copy gets an id of its own
+struct instance_id_t
+{
+  instance_id_t() : value(next()) {}
+  instance_id_t(const instance_id_t&) : instance_id_t() {}
+  instance_id_t& operator=(const instance_id_t&) { return *this; }
+
+  std::uint64_t value;
+
+private:
+  static std::uint64_t next()
+  {
+    static std::atomic<std::uint64_t> n{1};
+    return n.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+// Word resolved once by IReversedDictionary::prepare, to be searched again without lookup
+struct prepared_t
+{
+  std::string                 word;
+  std::shared_ptr<const void> location;  // Storage of the word, kept alive by the handle; null if not found
+  std::uint64_t               owner = 0; // instance_id_t of the dictionary that resolved location, 0 if none
+};
 
 // Each entry points to a contiguous array of c-string pointers
 using text_t = gsl::span<const char*>;
@@ -72,5 +117,34 @@ public:
   /// Remove a document
   virtual void     remove(int document_id)                                    = 0;
 
+  /// Search each of \p words, the results of words[i] go to out[i]
+  /// Implementations may interleave the lookups to overlap their cache misses
+  virtual void     search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const
+  {
+    for (std::size_t i = 0; i < words.size(); ++i)
+      out[i] = search(words[i]);
+  }
+
+  /// Resolve \p word once, for search_prepared
+  /// The default handle only keeps the word, each search looks it up again
+  virtual prepared_t prepare(const char* word) const { return {word, nullptr, 0}; }
+
+  /// Same as search(q.word), without the lookup if q was resolved by this dictionary
+  /// q stays valid across inserts and removes. If the storage of its word is
+  /// reclaimed meanwhile, the word is looked up again.
+  virtual result_t search_prepared(const prepared_t& q) const { return search(q.word.c_str()); }
+
+  /// Insert a new document from raw text, split into words by tokenize
+  /// If it already exists, nothing to do
+  virtual void     insert_text(int document_id, std::string_view raw)
+  {
+    // Reused from one text to the next by the calling thread
+    thread_local std::vector<char>        buffer;
+    thread_local std::vector<const char*> words;
+
+    tokenize(raw, buffer, words);
+    insert(document_id, words);
+  }
+
   /// \}
 };
@@ -0,0 +1,295 @@
+#include "adaptive_dictionary.hpp"
+
+#include <bitset>
+#include <cmath>
+#include <functional>
+
+#include "../fusion_implementation/fusion_dictionary.hpp"
+#include "../hashmap_implementation/hashmap_dictionary.hpp"
+#include "../trie_implementation/tree_dictionary.hpp"
+
+namespace
+{
+    constexpr std::size_t REPLAY_BATCH = 64; // Writes left in the log to replay with the writes held
+} // namespace
+
+Adaptive_Dictionary::document_t::document_t(int id, gsl::span<const char*> text)
+    : id(id)
+    , words(text.begin(), text.end())
+{
+    for (const std::string& word : words)
+        this->text.push_back(word.c_str());
+}
+
+Adaptive_Dictionary::Adaptive_Dictionary(engine_t initial, std::chrono::milliseconds period)
+    : sketch_(new std::atomic<std::uint64_t>[SKETCH_BITS / 64]())
+    , predicted_(initial)
+    , predicted_since_(std::chrono::steady_clock::now())
+    , period_(period)
+{
+    std::unique_lock w(write_m_);
+    publish(initial, make(initial));
+    if (period_.count() > 0)
+        adapter_ = std::thread([this] { run(); });
+}
+
+Adaptive_Dictionary::Adaptive_Dictionary(const dictionary_t& d)
+    : Adaptive_Dictionary()
+{
+    init(d);
+}
+
+Adaptive_Dictionary::~Adaptive_Dictionary()
+{
+    {
+        std::lock_guard l(cv_m_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (adapter_.joinable())
+        adapter_.join();
+}
+
+void Adaptive_Dictionary::init(const dictionary_t& d)
+{
+    std::lock_guard  m(migrate_m_);
+    std::unique_lock w(write_m_);
+
+    dictionary_t added;
+    for (const auto& [id, text] : d)
+    {
+        docs_t::accessor a;
+        if (!docs_.insert(a, id))
+            continue;
+        a->second = std::make_shared<document_t>(id, text);
+        sketch(*a->second);
+        words_ += a->second->words.size();
+        added.emplace(id, text);
+    }
+    current_.get()->dic->init(added);
+}
+
+result_t Adaptive_Dictionary::search(const char* word) const
+{
+    count_search(1);
+    return current_.read()->dic->search(word);
+}
+
+void Adaptive_Dictionary::search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const
+{
+    count_search(words.size());
+    current_.read()->dic->search_batch(words, out);
+}
+
+void Adaptive_Dictionary::insert(int document_id, gsl::span<const char*> text)
+{
+    std::shared_lock w(write_m_);
+
+    // The accessor orders the writes of a document in the log
+    docs_t::accessor a;
+    if (!docs_.insert(a, document_id))
+        return;
+    a->second = std::make_shared<document_t>(document_id, text);
+
+    current_.get()->dic->insert(document_id, text);
+    if (logging_)
+    {
+        std::lock_guard l(log_m_);
+        log_.push_back({document_id, a->second});
+    }
+    sketch(*a->second);
+    words_ += a->second->words.size();
+    inserts_++;
+}
+
+void Adaptive_Dictionary::remove(int document_id)
+{
+    std::shared_lock w(write_m_);
+
+    docs_t::accessor a;
+    if (!docs_.find(a, document_id))
+        return;
+
+    current_.get()->dic->remove(document_id);
+    if (logging_)
+    {
+        std::lock_guard l(log_m_);
+        log_.push_back({document_id, nullptr});
+    }
+    words_ -= a->second->words.size();
+    docs_.erase(a);
+    removes_++;
+}
+
+Adaptive_Dictionary::engine_t Adaptive_Dictionary::engine() const
+{
+    return current_.read()->engine;
+}
+
+Adaptive_Dictionary::stats_t Adaptive_Dictionary::stats() const
+{
+    stats_t s;
+    for (const stripe_t& stripe : stripes_)
+        s.searches += stripe.searches.load(std::memory_order_relaxed);
+    s.searches -= window_[0];
+    s.inserts   = inserts_ - window_[1];
+    s.removes   = removes_ - window_[2];
+    s.documents = docs_.size();
+    if (s.documents > 0)
+        s.words_per_document = double(words_) / double(s.documents);
+
+    // Linear counting: n distinct words leave about m * exp(-n / m) of the m bits unset
+    std::size_t unset = 0;
+    for (std::size_t i = 0; i < SKETCH_BITS / 64; ++i)
+        unset += 64 - std::bitset<64>(sketch_[i].load(std::memory_order_relaxed)).count();
+    s.vocabulary = unset == 0 ? SKETCH_BITS : std::size_t(-double(SKETCH_BITS) * std::log(double(unset) / SKETCH_BITS));
+    return s;
+}
+
+Adaptive_Dictionary::engine_t Adaptive_Dictionary::predict(const stats_t& window)
+{
+    const std::uint64_t writes = window.inserts + window.removes;
+    const std::uint64_t ops    = window.searches + writes;
+    if (ops == 0 || double(writes) < WRITE_HEAVY * double(ops))
+        return engine_t::fusion;
+    return window.vocabulary < LARGE_VOCABULARY ? engine_t::hashmap : engine_t::tree;
+}
+
+bool Adaptive_Dictionary::adapt()
+{
+    std::lock_guard l(adapt_m_);
+
+    const stats_t window = stats();
+    if (window.searches + window.inserts + window.removes < MIN_WINDOW)
+        return false;
+    window_[0] += window.searches;
+    window_[1] += window.inserts;
+    window_[2] += window.removes;
+
+    // Like renting skis until the rent paid would have bought them: the current
+    // engine is kept until the time lost on it equals the time a migration takes.
+    // A single window may be a burst, so the engine never changes on the first one.
+    const engine_t e   = predict(window);
+    const auto     now = std::chrono::steady_clock::now();
+    if (e != predicted_)
+    {
+        predicted_       = e;
+        predicted_since_ = now;
+        return false;
+    }
+    if (e == engine() || now - predicted_since_ < last_migration_)
+        return false;
+
+    migrate(e);
+    last_migration_ = std::chrono::steady_clock::now() - now;
+    return true;
+}
+
+void Adaptive_Dictionary::migrate(engine_t e)
+{
+    std::lock_guard m(migrate_m_);
+    if (e == engine())
+        return;
+
+    // The documents are copied with the writes held, the writes after are logged
+    std::vector<std::shared_ptr<document_t>> view;
+    {
+        std::unique_lock w(write_m_);
+        view.reserve(docs_.size());
+        for (const auto& [id, doc] : docs_)
+            view.push_back(doc);
+        logging_ = true;
+    }
+
+    dictionary_t d;
+    for (const auto& doc : view)
+        d.emplace(doc->id, doc->text);
+    std::shared_ptr<IReversedDictionary> next = make(e);
+    next->init(d);
+
+    // Most of the log is replayed with the writes going on, its end with them held
+    const auto replay = [&next](const std::vector<op_t>& ops) {
+        for (const op_t& op : ops)
+        {
+            if (op.doc)
+                next->insert(op.id, op.doc->text);
+            else
+                next->remove(op.id);
+        }
+    };
+    std::vector<op_t> ops;
+    do
+    {
+        ops = take_log();
+        replay(ops);
+    } while (ops.size() > REPLAY_BATCH);
+
+    {
+        std::unique_lock w(write_m_);
+        replay(take_log());
+        logging_ = false;
+        publish(e, std::move(next));
+    }
+    current_.collect();
+    migrations_++;
+}
+
+int Adaptive_Dictionary::migrations() const
+{
+    return migrations_.load();
+}
+
+std::unique_ptr<IReversedDictionary> Adaptive_Dictionary::make(engine_t e)
+{
+    switch (e)
+    {
+    case engine_t::hashmap: return std::make_unique<hashmap_dictionary>();
+    case engine_t::tree: return std::make_unique<Tree_Dictionary>();
+    case engine_t::fusion: return std::make_unique<Fusion_Dictionary>();
+    }
+    return nullptr;
+}
+
+void Adaptive_Dictionary::publish(engine_t e, std::shared_ptr<IReversedDictionary> dic)
+{
+    current_.store(std::make_shared<const current_t>(current_t{e, std::move(dic)}));
+}
+
+void Adaptive_Dictionary::count_search(std::uint64_t n) const
+{
+    static std::atomic<unsigned> next{0};
+    thread_local const unsigned  stripe = next++ % N_STRIPES;
+    stripes_[stripe].searches.fetch_add(n, std::memory_order_relaxed);
+}
+
+void Adaptive_Dictionary::sketch(const document_t& doc)
+{
+    for (const std::string& word : doc.words)
+    {
+        const std::size_t   bit  = std::hash<std::string>{}(word) % SKETCH_BITS;
+        const std::uint64_t mask = std::uint64_t(1) << (bit % 64);
+        auto&               cell = sketch_[bit / 64];
+        // Most words are already there: the cache line is only written for new ones
+        if ((cell.load(std::memory_order_relaxed) & mask) == 0)
+            cell.fetch_or(mask, std::memory_order_relaxed);
+    }
+}
+
+std::vector<Adaptive_Dictionary::op_t> Adaptive_Dictionary::take_log()
+{
+    std::vector<op_t> ops;
+    std::lock_guard   l(log_m_);
+    ops.swap(log_);
+    return ops;
+}
+
+void Adaptive_Dictionary::run()
+{
+    std::unique_lock l(cv_m_);
+    while (!cv_.wait_for(l, period_, [this] { return stop_; }))
+    {
+        l.unlock();
+        adapt();
+        l.lock();
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tbb/concurrent_hash_map.h>
+
+#include "../IDictionary.hpp"
+#include "../epoch_ptr.hpp"
+
+/// Reversed dictionary moving its documents to the engine best suited to the workload
+///
+/// The searches, inserts and removes are counted, and the vocabulary estimated
+/// from the inserted words. Every period, adapt() predicts the fastest engine
+/// from the last window of operations (see predict()). Once another engine has
+/// been predicted for as long as the last migration took, the documents migrate
+/// to it: a new engine is built in the background from a copy of the documents,
+/// then the writes made during the build are replayed on it and it replaces the
+/// current one. Searches go to the current engine all along and never wait.
+///
+/// The documents are kept to build the engines from, so the memory is about
+/// doubled compared to the engine alone. A replaced engine is freed once the
+/// searches started on it are done.
+class Adaptive_Dictionary : public IReversedDictionary
+{
+public:
+    enum class engine_t
+    {
+        hashmap,
+        tree,
+        fusion
+    };
+
+    /// Operations counted since the last adapt(), and shape of the index
+    struct stats_t
+    {
+        std::uint64_t searches           = 0;
+        std::uint64_t inserts            = 0;
+        std::uint64_t removes            = 0;
+        std::size_t   documents          = 0;
+        std::size_t   vocabulary         = 0; // Distinct words ever inserted, estimated
+        double        words_per_document = 0;
+    };
+
+    static constexpr double        WRITE_HEAVY      = 0.1;   // Share of writes from which fusion loses
+    static constexpr std::size_t   LARGE_VOCABULARY = 50000; // Distinct words from which the trie beats the hashmap
+    static constexpr std::uint64_t MIN_WINDOW       = 10000; // Operations for adapt() to predict anything
+    static constexpr int           N_STRIPES        = 64;    // Search counters, threads beyond share them
+
+    /// The background thread calls adapt() every period, none if period is zero
+    explicit Adaptive_Dictionary(engine_t initial = engine_t::fusion,
+                                 std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+    Adaptive_Dictionary(const dictionary_t& d);
+    ~Adaptive_Dictionary();
+
+    virtual void     init(const dictionary_t& d) final;
+    virtual result_t search(const char* word) const final;
+    virtual void     search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const final;
+    virtual void     insert(int document_id, gsl::span<const char*> text) final;
+    virtual void     remove(int document_id) final;
+
+    /// Engine the searches go to
+    engine_t engine() const;
+
+    /// Operations since the last adapt()
+    stats_t stats() const;
+
+    /// Fastest engine on the benchmark scenarios for this workload
+    /// Read-mostly workloads go to fusion, whose word index is the fastest to search.
+    /// Under writes, the hashmap inserts fastest, until the vocabulary is large enough
+    /// for its buckets to miss the cache more than the trie nodes.
+    static engine_t predict(const stats_t& window);
+
+    /// Predict the engine from the operations since the last call and migrate if
+    /// the previous calls predicted it for long enough. Returns true if the engine changed.
+    bool adapt();
+
+    /// Move the documents to engine e, the writes go on meanwhile
+    void migrate(engine_t e);
+
+    /// Migrations done since construction
+    int migrations() const;
+
+private:
+    // Words of a document, kept to build the next engine
+    struct document_t
+    {
+        document_t(int id, gsl::span<const char*> text);
+
+        int                      id;
+        std::vector<std::string> words;
+        std::vector<const char*> text; // Points to words
+    };
+
+    // Write made during a migration, doc is null for a remove
+    struct op_t
+    {
+        int                         id;
+        std::shared_ptr<document_t> doc;
+    };
+
+    struct current_t
+    {
+        engine_t                             engine;
+        std::shared_ptr<IReversedDictionary> dic;
+    };
+
+    struct alignas(64) stripe_t
+    {
+        std::atomic<std::uint64_t> searches{0};
+    };
+
+    static std::unique_ptr<IReversedDictionary> make(engine_t e);
+
+    // Publish a new engine, write_m_ locked. The old one is freed by current_.collect()
+    void publish(engine_t e, std::shared_ptr<IReversedDictionary> dic);
+
+    void count_search(std::uint64_t n) const;
+
+    // Set the bits of the words in the vocabulary sketch
+    void sketch(const document_t& doc);
+
+    std::vector<op_t> take_log();
+
+    void run();
+
+    using docs_t = tbb::concurrent_hash_map<int, std::shared_ptr<document_t>>;
+
+    static constexpr std::size_t SKETCH_BITS = 1 << 20;
+
+    docs_t docs_;
+
+    Epoch_Ptr<current_t> current_;
+    std::shared_mutex    write_m_; // Shared by writers, exclusive to start and end a migration
+    std::mutex           migrate_m_;
+
+    bool              logging_ = false; // Writes are logged for the engine being built
+    std::mutex        log_m_;
+    std::vector<op_t> log_;
+
+    mutable stripe_t           stripes_[N_STRIPES];
+    std::atomic<std::uint64_t> inserts_{0};
+    std::atomic<std::uint64_t> removes_{0};
+    std::atomic<std::uint64_t> words_{0};       // Words of the live documents
+    std::atomic<std::uint64_t> window_[3] = {}; // Searches, inserts and removes at the last adapt()
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> sketch_; // Linear counting of the distinct words
+
+    std::mutex                            adapt_m_;
+    engine_t                              predicted_;        // By the last adapt()
+    std::chrono::steady_clock::time_point predicted_since_;  // First adapt() in a row to predict predicted_
+    std::chrono::steady_clock::duration   last_migration_{}; // Build time of the last migration
+    std::atomic<int>                      migrations_{0};
+
+    const std::chrono::milliseconds period_;
+    std::mutex                      cv_m_; // To lock when sleeping or waking the adapter up
+    std::condition_variable         cv_;
+    bool                            stop_ = false;
+    std::thread                     adapter_;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+/// What an async dictionary does with an operation arriving on a full queue
+enum class overload_policy
+{
+    block,           // Wait for some room
+    reject,          // Fail the operation with an overload_error
+    drop_oldest_read // Fail the oldest queued search instead, writes are rejected
+};
+
+/// Bounds of the queues of an async dictionary
+struct admission_config_t
+{
+    std::size_t     max_reads  = 1 << 16; // Queued searches, rounded up to a power of 2
+    std::size_t     max_writes = 1 << 16; // Writes not completed yet
+    overload_policy policy     = overload_policy::block;
+};
+
+/// Gauges and counters of the queues of an async dictionary
+struct admission_stats_t
+{
+    std::size_t read_depth;  // Searches queued, not started yet
+    std::size_t write_depth; // Writes not completed yet
+    std::size_t rejected;    // Operations failed on a full queue
+    std::size_t dropped;     // Queued searches failed to make room for new ones
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// Pin the thread t to cpu
+/// Best effort: does nothing where thread affinity is not supported.
+inline void pin_thread([[maybe_unused]] std::thread::native_handle_type t, [[maybe_unused]] int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(t, sizeof(set), &set);
+#endif
+}
+
+/// Pin the calling thread to cpu
+inline void pin_this_thread([[maybe_unused]] int cpu)
+{
+#ifdef __linux__
+    pin_thread(pthread_self(), cpu);
+#endif
+}
+
+#ifdef __linux__
+using cpu_mask_t = cpu_set_t;
+#else
+struct cpu_mask_t
+{};
+#endif
+
+/// CPUs the calling thread may run on
+inline cpu_mask_t this_thread_affinity()
+{
+    cpu_mask_t mask{};
+#ifdef __linux__
+    pthread_getaffinity_np(pthread_self(), sizeof(mask), &mask);
+#endif
+    return mask;
+}
+
+/// Restore a mask given by this_thread_affinity
+inline void set_this_thread_affinity([[maybe_unused]] const cpu_mask_t& mask)
+{
+#ifdef __linux__
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+#endif
+}
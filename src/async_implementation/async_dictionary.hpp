@@ -2,14 +2,35 @@
 
 #include "../IAsyncDictionary.hpp"
 #include <tbb/task_group.h>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include "admission.hpp"
+#include "async_stats.hpp"
+#include "ring.hpp"
 #include "thread_pool.hpp"
+#include "write_coalescer.hpp"
 
 template <typename DICTIONARY>
 class Async_Dictionary : public IAsyncReversedDictionary
 {
 public:
+    static constexpr std::size_t SEARCH_BATCH = 16; // Queued searches run at once by search_batch
+
     Async_Dictionary() {}
 
+    /// Run the searches on read_workers threads and the writes on write_workers threads
+    Async_Dictionary(int read_workers, int write_workers)
+        : thread_pool_(read_workers, write_workers)
+    {}
+
+    /// Run the operations on the workers described by config, with the queues bounded by admission
+    explicit Async_Dictionary(const executor_config_t& config, const admission_config_t& admission = {})
+        : admission_(admission)
+        , reads_(admission.max_reads)
+        , thread_pool_(config)
+    {}
+
     Async_Dictionary(const dictionary_t& d)
     {
         m_dic.init(d);
@@ -24,40 +45,177 @@ public:
     {
         auto p = new std::promise<result_t>;
         auto futur = p->get_future();
-        thread_pool_.push([this, query, p]() {
-            p->set_value(this->m_dic.search(query));
-            delete p;
-        });
+        read_t r{query, p, stats_clock(), nullptr};
+        if (trace_handoff_)
+            futur = timings_.traced(std::move(futur), request_t::search, r.done = std::make_shared<std::atomic<std::int64_t>>());
+        if (!admit_read(r))
+            return futur;
+
+        // Each task serves the searches queued so far, up to SEARCH_BATCH, not always
+        // this one: the others find the queue empty
+        thread_pool_.push([this]() { serve_reads(); });
         return futur;
     }
 
     std::future<void> insert(int doc_id, gsl::span<const char*> text)
     {
-        auto p = new std::promise<void>;
-        auto futur = p->get_future();
-        thread_pool_.push([this, doc_id, text, p]() {
-            this->m_dic.insert(doc_id, text);
-            p->set_value();
-            delete p;
-        });
+        typename Write_Coalescer<DICTIONARY>::waiter_t w{new std::promise<void>, stats_clock(), nullptr};
+        auto futur = traced(w, request_t::insert);
+        if (admit_write(w.p))
+            writes_.insert(doc_id, text, std::move(w));
         return futur;
     }
 
     std::future<void> remove(int doc_id)
     {
-        auto p = new std::promise<void>;
-        auto futur = p->get_future();
-        thread_pool_.push([this, doc_id, p]()
-        {
-            this->m_dic.remove(doc_id);
-            p->set_value();
-            delete p;
-        });
+        typename Write_Coalescer<DICTIONARY>::waiter_t w{new std::promise<void>, stats_clock(), nullptr};
+        auto futur = traced(w, request_t::remove);
+        if (admit_write(w.p))
+            writes_.remove(doc_id, std::move(w));
         return futur;
     }
 
+    /// Also time the handoff of the results to the clients, at the cost of an
+    /// allocation and a deferred future per operation
+    void trace_handoff(bool on)
+    {
+        trace_handoff_ = on;
+    }
+
+    /// Time spent by the operations in each phase, and busy ratio of the workers
+    async_stats_t timings() const
+    {
+        auto s = timings_.snapshot();
+        s.workers = thread_pool_.workers();
+        return s;
+    }
+
+    /// Writes submitted and applied, once coalesced
+    const Write_Coalescer<DICTIONARY>& writes() const
+    {
+        return writes_;
+    }
+
+    admission_stats_t stats() const
+    {
+        return {reads_.size(), writes_.pending(), rejected_, dropped_};
+    }
+
   DICTIONARY m_dic;
 private:
+    struct read_t
+    {
+        const char*                                word;
+        std::promise<result_t>*                    p;
+        std::int64_t                               submitted; // stats_clock()
+        std::shared_ptr<std::atomic<std::int64_t>> done;      // Completion time, if traced
+    };
+
+    void serve_reads() const
+    {
+        read_t      batch[SEARCH_BATCH];
+        std::size_t n = 0;
+        while (n < SEARCH_BATCH && reads_.try_pop(batch[n]))
+            ++n;
+        if (n == 0)
+            return;
+
+        const std::int64_t start = stats_clock();
+        result_t           results[SEARCH_BATCH];
+        if constexpr (std::is_base_of_v<IReversedDictionary, DICTIONARY>)
+        {
+            const char* words[SEARCH_BATCH];
+            for (std::size_t i = 0; i < n; ++i)
+                words[i] = batch[i].word;
+            m_dic.search_batch({words, n}, {results, n});
+        }
+        else
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                results[i] = m_dic.search(batch[i].word);
+        }
+        const std::int64_t end = stats_clock();
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            // The batch time is shared by its searches
+            timings_.record(request_t::search, phase::queued, start - batch[i].submitted);
+            timings_.record(request_t::search, phase::execution, (end - start) / std::int64_t(n));
+            if (batch[i].done)
+                batch[i].done->store(end);
+            batch[i].p->set_value(results[i]);
+            delete batch[i].p;
+        }
+    }
+
+    std::future<void> traced(typename Write_Coalescer<DICTIONARY>::waiter_t& w, request_t::op_t op)
+    {
+        auto futur = w.p->get_future();
+        if (trace_handoff_)
+            futur = timings_.traced(std::move(futur), op, w.done = std::make_shared<std::atomic<std::int64_t>>());
+        return futur;
+    }
+
+    template <typename T>
+    static void fail(std::promise<T>* p, const char* why)
+    {
+        p->set_exception(std::make_exception_ptr(overload_error(why)));
+        delete p;
+    }
+
+    // Queue r, or fail it on a full queue and return false
+    bool admit_read(const read_t& r) const
+    {
+        while (!reads_.try_push(r))
+        {
+            read_t oldest;
+            switch (admission_.policy)
+            {
+            case overload_policy::block:
+                std::this_thread::yield();
+                break;
+            case overload_policy::reject:
+                ++rejected_;
+                fail(r.p, "too many queued searches");
+                return false;
+            case overload_policy::drop_oldest_read:
+                if (reads_.try_pop(oldest))
+                {
+                    ++dropped_;
+                    fail(oldest.p, "search dropped for a newer one");
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Return false if p was failed on a full queue
+    bool admit_write(std::promise<void>* p)
+    {
+        while (writes_.pending() >= admission_.max_writes)
+        {
+            if (admission_.policy == overload_policy::block)
+                std::this_thread::yield();
+            else
+            {
+                ++rejected_;
+                fail(p, "too many pending writes");
+                return false;
+            }
+        }
+        return true;
+    }
+
+  const admission_config_t admission_{};
+  mutable Ring<read_t>     reads_{admission_.max_reads}; // Searches not started yet
+
+  mutable std::atomic<std::size_t> rejected_{0};
+  mutable std::atomic<std::size_t> dropped_{0};
 
+  // Before the pool: the pool waits for the operations in flight when destroyed
+  mutable Async_Stats         timings_;
+  std::atomic<bool>           trace_handoff_{false};
+  Write_Coalescer<DICTIONARY> writes_{m_dic, thread_pool_, &timings_};
   mutable Thread_Pool thread_pool_;
-};
\ No newline at end of file
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+
+#include "completion_queue.hpp"
+
+/// Clock of the async statistics, in nanoseconds
+inline std::int64_t stats_clock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Phases of an async operation
+enum class phase
+{
+    queued,    // From the submission to the start of the execution
+    execution, // In the dictionary
+    handoff    // From the completion to the call to get() by the client
+};
+
+/// Durations counted in buckets of powers of 2 nanoseconds
+struct histogram_t
+{
+    static constexpr int N_BUCKETS = 32; // Bucket i counts [2^i, 2^(i+1)) ns, the last one all the longer ones
+
+    std::uint64_t buckets[N_BUCKETS] = {};
+    std::uint64_t count              = 0;
+    std::uint64_t total_ns           = 0;
+
+    double mean_ns() const
+    {
+        return count > 0 ? double(total_ns) / double(count) : 0.;
+    }
+
+    /// Upper bound of the durations of the fraction q of the operations
+    std::uint64_t quantile_ns(double q) const
+    {
+        const auto rank = std::uint64_t(q * double(count));
+        std::uint64_t seen = 0;
+        for (int i = 0; i < N_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+                return std::uint64_t(2) << i;
+        }
+        return 0;
+    }
+};
+
+/// Snapshot of the statistics of an async dictionary
+struct async_stats_t
+{
+    static constexpr int N_OPS    = 3; // request_t::op_t
+    static constexpr int N_PHASES = 3;
+
+    histogram_t   phases[N_OPS][N_PHASES];
+    std::uint64_t elapsed_ns = 0; // Since the statistics were created
+    int           workers    = 0;
+
+    const histogram_t& of(request_t::op_t op, phase p) const
+    {
+        return phases[op][int(p)];
+    }
+
+    /// Fraction of the time the workers spent running operations, the rest is idle
+    double busy_ratio() const
+    {
+        std::uint64_t busy = 0;
+        for (auto& op : phases)
+            busy += op[int(phase::execution)].total_ns;
+        return elapsed_ns > 0 && workers > 0 ? double(busy) / (double(elapsed_ns) * workers) : 0.;
+    }
+};
+
+/// Statistics of an async dictionary, collected per thread
+/// Each thread counts in a cache line aligned slot of its own (threads beyond
+/// MAX_THREADS share them), so recording is a few uncontended increments.
+class Async_Stats
+{
+public:
+    static constexpr int MAX_THREADS = 128;
+
+    Async_Stats()
+        : start_(stats_clock())
+        , slots_(std::make_unique<slot_t[]>(MAX_THREADS))
+    {}
+
+    void record(request_t::op_t op, phase p, std::int64_t ns)
+    {
+        counters_t& c = slots_[thread_index() % MAX_THREADS].phases[op][int(p)];
+        const auto d = std::uint64_t(std::max<std::int64_t>(ns, 0));
+        c.buckets[bucket(d)].fetch_add(1, std::memory_order_relaxed);
+        c.count.fetch_add(1, std::memory_order_relaxed);
+        c.total_ns.fetch_add(d, std::memory_order_relaxed);
+    }
+
+    /// Sum of the slots, while the threads go on counting
+    async_stats_t snapshot() const
+    {
+        async_stats_t s;
+        s.elapsed_ns = std::uint64_t(stats_clock() - start_);
+        for (int t = 0; t < MAX_THREADS; ++t)
+            for (int op = 0; op < async_stats_t::N_OPS; ++op)
+                for (int p = 0; p < async_stats_t::N_PHASES; ++p)
+                {
+                    const counters_t& c = slots_[t].phases[op][p];
+                    histogram_t&      h = s.phases[op][p];
+                    for (int b = 0; b < histogram_t::N_BUCKETS; ++b)
+                        h.buckets[b] += c.buckets[b].load(std::memory_order_relaxed);
+                    h.count += c.count.load(std::memory_order_relaxed);
+                    h.total_ns += c.total_ns.load(std::memory_order_relaxed);
+                }
+        return s;
+    }
+
+    /// Wrap f so that its get() records the time since *done, the completion time
+    /// set before f is ready. The statistics must outlive the returned future.
+    template <typename T>
+    std::future<T> traced(std::future<T> f, request_t::op_t op, std::shared_ptr<const std::atomic<std::int64_t>> done)
+    {
+        return std::async(std::launch::deferred, [this, op, f = std::move(f), done = std::move(done)]() mutable {
+            auto record_handoff = [&] { record(op, phase::handoff, stats_clock() - done->load()); };
+            if constexpr (std::is_void_v<T>)
+            {
+                f.get();
+                record_handoff();
+            }
+            else
+            {
+                T r = f.get();
+                record_handoff();
+                return r;
+            }
+        });
+    }
+
+private:
+    struct counters_t
+    {
+        std::atomic<std::uint64_t> buckets[histogram_t::N_BUCKETS];
+        std::atomic<std::uint64_t> count;
+        std::atomic<std::uint64_t> total_ns;
+    };
+
+    struct alignas(64) slot_t
+    {
+        counters_t phases[async_stats_t::N_OPS][async_stats_t::N_PHASES];
+    };
+
+    static int bucket(std::uint64_t ns)
+    {
+        return ns == 0 ? 0 : std::min(63 - __builtin_clzll(ns), histogram_t::N_BUCKETS - 1);
+    }
+
+    static unsigned thread_index()
+    {
+        static std::atomic<unsigned> next{0};
+        thread_local const unsigned index = next++;
+        return index;
+    }
+
+    std::int64_t              start_;
+    std::unique_ptr<slot_t[]> slots_; // Value initialized: all zeros
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../IAwaitableDictionary.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+template <typename DICTIONARY>
+class Awaitable_Dictionary : public IAwaitableReversedDictionary
+{
+public:
+    Awaitable_Dictionary() {}
+
+    Awaitable_Dictionary(const dictionary_t& d)
+    {
+        m_dic.init(d);
+    }
+
+    void init(const dictionary_t& d)
+    {
+        m_dic.init(d);
+    }
+
+    DICTIONARY m_dic;
+
+protected:
+    void start(operation& op)
+    {
+        // op lives in the frame of the suspended coroutine until complete()
+        switch (op.request.op)
+        {
+        case request_t::search:
+            thread_pool_.push([this, &op]() {
+                op.result = m_dic.search(op.request.word);
+                op.complete();
+            });
+            break;
+        case request_t::insert:
+            thread_pool_.push_write([this, &op]() {
+                m_dic.insert(op.request.document_id, op.request.text);
+                op.complete();
+            });
+            break;
+        case request_t::remove:
+            thread_pool_.push_write([this, &op]() {
+                m_dic.remove(op.request.document_id);
+                op.complete();
+            });
+            break;
+        }
+    }
+
+private:
+    Thread_Pool thread_pool_;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include "../IDictionary.hpp"
+#include "ring.hpp"
+
+class Completion_Queue;
+
+// Structure of a request submitted to a queued dictionary
+struct request_t
+{
+    enum op_t
+    {
+        search,
+        insert,
+        remove
+    };
+
+    op_t                   op;
+    std::uint64_t          tag         = 0;       // Given back with the completion
+    Completion_Queue*      cq          = nullptr; // Where the completion is posted, nullptr for none
+    const char*            word        = nullptr; // search
+    int                    document_id = 0;       // insert, remove
+    gsl::span<const char*> text;                  // insert
+};
+
+// Structure of the completion of a request
+struct response_t
+{
+    std::uint64_t tag;
+    result_t      result; // Empty for insert and remove
+};
+
+/// Completions of the requests of one client
+/// Workers post to it and the client reaps the completions in batches, without any
+/// allocation nor lock. A client must not have more requests in flight than its capacity.
+class Completion_Queue
+{
+public:
+    explicit Completion_Queue(std::size_t capacity = 1 << 12)
+        : ring_(capacity)
+    {}
+
+    /// Move up to max completions into out, return how many
+    std::size_t reap(response_t* out, std::size_t max)
+    {
+        std::size_t n = 0;
+        while (n < max && ring_.try_pop(out[n]))
+            ++n;
+        return n;
+    }
+
+    /// Same as reap, waiting for at least min completions
+    std::size_t wait(response_t* out, std::size_t max, std::size_t min = 1)
+    {
+        std::size_t n = reap(out, max);
+        while (n < min)
+        {
+            std::this_thread::yield();
+            n += reap(out + n, max - n);
+        }
+        return n;
+    }
+
+    /// Called by the workers
+    void post(const response_t& r)
+    {
+        while (!ring_.try_push(r))
+            std::this_thread::yield();
+    }
+
+    std::size_t capacity() const
+    {
+        return ring_.capacity();
+    }
+
+private:
+    Ring<response_t> ring_;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../IAsyncDictionary.hpp"
+#include "completion_queue.hpp"
+#include "ring.hpp"
+
+/// Dictionary served by worker threads polling a submission ring
+/// Submitting and completing a request takes no lock and no allocation. Idle
+/// workers poll a little, then sleep until a submission finds them asleep.
+template <typename DICTIONARY>
+class Queued_Dictionary : public IQueuedReversedDictionary
+{
+public:
+    static constexpr int SPINS = 256; // Empty polls before a worker sleeps
+
+    explicit Queued_Dictionary(int n_workers = int(std::max(1u, std::thread::hardware_concurrency())),
+                               std::size_t ring_size = 1 << 14)
+        : ring_(ring_size)
+    {
+        for (int i = 0; i < n_workers; ++i)
+            workers_.emplace_back([this] { work(); });
+    }
+
+    Queued_Dictionary(const dictionary_t& d)
+        : Queued_Dictionary()
+    {
+        m_dic.init(d);
+    }
+
+    ~Queued_Dictionary()
+    {
+        {
+            std::lock_guard l(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_)
+            w.join();
+    }
+
+    void init(const dictionary_t& d)
+    {
+        m_dic.init(d);
+    }
+
+    bool submit(const request_t& r)
+    {
+        if (!ring_.try_push(r))
+            return false;
+
+        // Either a worker going to sleep sees r in the ring, or it is seen sleeping here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard l(m_);
+            cv_.notify_one();
+        }
+        return true;
+    }
+
+    DICTIONARY m_dic;
+
+private:
+    void work()
+    {
+        request_t r;
+        int idle = 0;
+        while (true)
+        {
+            if (ring_.try_pop(r))
+            {
+                execute(r);
+                idle = 0;
+            }
+            else if (++idle < SPINS)
+                std::this_thread::yield();
+            else
+            {
+                std::unique_lock l(m_);
+                sleeping_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                cv_.wait(l, [this] { return stop_ || !ring_.empty(); });
+                sleeping_.fetch_sub(1);
+                if (stop_ && ring_.empty())
+                    return;
+                idle = 0;
+            }
+        }
+    }
+
+    void execute(const request_t& r)
+    {
+        response_t c{r.tag, {}};
+        switch (r.op)
+        {
+        case request_t::search: c.result = m_dic.search(r.word); break;
+        case request_t::insert: m_dic.insert(r.document_id, r.text); break;
+        case request_t::remove: m_dic.remove(r.document_id); break;
+        }
+
+        if (r.cq != nullptr)
+            r.cq->post(c);
+    }
+
+    Ring<request_t>          ring_;
+    std::vector<std::thread> workers_;
+
+    std::mutex              m_; // To lock when sleeping or waking a worker up
+    std::condition_variable cv_;
+    std::atomic<int>        sleeping_{0};
+    bool                    stop_ = false;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/// Bounded lock-free queue for several producers and several consumers
+/// Each cell holds a sequence number telling whether it is ready to be written or
+/// read for the current lap, so producers only contend on tail_ and consumers on head_.
+template <typename T>
+class Ring
+{
+public:
+    /// capacity is rounded up to a power of 2
+    explicit Ring(std::size_t capacity)
+    {
+        std::size_t n = 2;
+        while (n < capacity)
+            n *= 2;
+
+        cells_ = std::make_unique<cell[]>(n);
+        mask_  = n - 1;
+        for (std::size_t i = 0; i < n; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// Return false if the ring is full
+    bool try_push(const T& value)
+    {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell& c = cells_[pos & mask_];
+            const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+            if (seq == pos)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.value = value;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos)
+                return false; // The cell still holds the value of the previous lap
+            else
+                pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// Return false if the ring is empty
+    bool try_pop(T& value)
+    {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell& c = cells_[pos & mask_];
+            const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+            if (seq == pos + 1)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = c.value;
+                    c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos + 1)
+                return false; // Not written yet for this lap
+            else
+                pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// Number of values, only exact when no other thread uses the ring
+    std::size_t size() const
+    {
+        const std::size_t tail = tail_.load(std::memory_order_acquire);
+        const std::size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        T                        value;
+    };
+
+    std::unique_ptr<cell[]> cells_;
+    std::size_t             mask_;
+
+    alignas(64) std::atomic<std::size_t> head_{0}; // Next position to pop
+    alignas(64) std::atomic<std::size_t> tail_{0}; // Next position to push
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <thread>
+#include <utility>
+
+#include "ring.hpp"
+
+class Scheduler;
+
+/// Coroutine to be started by Scheduler::spawn
+/// Its frame is destroyed when it returns, or with the Task if it was never spawned.
+class Task
+{
+public:
+    struct promise_type
+    {
+        Scheduler* scheduler = nullptr;
+
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept;
+
+        void return_void()
+        {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {}
+
+    // A frame is spawned once, by the only Task owning it
+    Task(const Task&)            = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task(Task&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+private:
+    friend class Scheduler;
+
+    std::coroutine_handle<promise_type> handle_; // Null once spawned
+};
+
+/// Single-threaded event loop resuming coroutines
+/// The spawned coroutines only run in run(): the operations they await complete on
+/// other threads, which post them back here.
+/// A coroutine is queued at most once at a time, so with no more coroutines alive
+/// than the capacity of the queue, posting one always finds room.
+class Scheduler
+{
+public:
+    explicit Scheduler(std::size_t capacity = 1 << 16)
+        : ready_(capacity)
+    {}
+
+    /// Start task in run(), which then owns its frame
+    /// Return false, and destroy the frame, if capacity coroutines are already alive
+    bool spawn(Task task)
+    {
+        if (alive_.fetch_add(1) >= int(ready_.capacity()))
+        {
+            alive_.fetch_sub(1);
+            return false;
+        }
+        const auto h = std::exchange(task.handle_, nullptr);
+        h.promise().scheduler = this;
+        post(h);
+        return true;
+    }
+
+    /// Queue h to be resumed by run(), from any thread
+    void post(std::coroutine_handle<> h)
+    {
+        // Only spins while run() takes a coroutine out of the cell it needs
+        while (!ready_.try_push(h))
+            std::this_thread::yield();
+    }
+
+    /// Resume the queued coroutines until all the spawned ones have returned
+    void run()
+    {
+        Scheduler* previous = current_;
+        current_ = this;
+
+        std::coroutine_handle<> h;
+        while (alive_.load() > 0)
+        {
+            if (ready_.try_pop(h))
+                h.resume();
+            else
+                std::this_thread::yield();
+        }
+
+        current_ = previous;
+    }
+
+    /// Scheduler running on the calling thread, nullptr if none
+    static Scheduler* current()
+    {
+        return current_;
+    }
+
+private:
+    friend Task::promise_type;
+
+    Ring<std::coroutine_handle<>> ready_;
+    std::atomic<int>              alive_{0}; // Spawned coroutines that have not returned yet
+
+    static inline thread_local Scheduler* current_ = nullptr;
+};
+
+inline std::suspend_never Task::promise_type::final_suspend() noexcept
+{
+    if (scheduler != nullptr)
+        scheduler->alive_.fetch_sub(1);
+    return {};
+}
+
+#endif
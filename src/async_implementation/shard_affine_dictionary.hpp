@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
+#include "../IAsyncDictionary.hpp"
+#include "affinity.hpp"
+#include "completion_queue.hpp"
+#include "ring.hpp"
+
+/// Dictionary split in shards, each one owned by a worker pinned to a core
+/// A document lives in the shard doc_id % n_shards: writes go to that shard only, a
+/// search goes to every shard and its results are merged. A shard is only touched by
+/// its worker, so its data stays in the cache of that core and its locks are never contended.
+template <typename DICTIONARY>
+class Shard_Affine_Dictionary : public IAsyncReversedDictionary
+{
+public:
+    static constexpr int SPINS = 256; // Empty polls before a worker sleeps
+
+    explicit Shard_Affine_Dictionary(int n_shards = int(std::max(1u, std::thread::hardware_concurrency())),
+                                     bool pin = true, std::size_t ring_size = 1 << 12)
+    {
+        const int n_cpus = int(std::max(1u, std::thread::hardware_concurrency()));
+        for (int i = 0; i < n_shards; ++i)
+        {
+            shards_.push_back(std::make_unique<shard_t>(ring_size));
+            shard_t& s = *shards_.back();
+            s.worker = std::thread([this, &s] { work(s); });
+            if (pin)
+                pin_thread(s.worker.native_handle(), i % n_cpus);
+        }
+    }
+
+    Shard_Affine_Dictionary(const dictionary_t& d)
+        : Shard_Affine_Dictionary()
+    {
+        init(d);
+    }
+
+    ~Shard_Affine_Dictionary()
+    {
+        for (auto& s : shards_)
+        {
+            {
+                std::lock_guard l(s->m);
+                s->stop = true;
+            }
+            s->cv.notify_one();
+        }
+        for (auto& s : shards_)
+            s->worker.join();
+    }
+
+    void init(const dictionary_t& d)
+    {
+        std::vector<dictionary_t> parts(shards_.size());
+        for (auto& [id, text] : d)
+            parts[shard_of(id)].emplace(id, text);
+
+        tbb::parallel_for(std::size_t(0), shards_.size(), [&](std::size_t i) { shards_[i]->dic.init(parts[i]); });
+    }
+
+    std::future<result_t> search(const char* word) const
+    {
+        auto g = new gather_t;
+        g->remaining = int(shards_.size());
+        auto futur = g->p.get_future();
+
+        job_t j;
+        j.op     = request_t::search;
+        j.word   = word;
+        j.gather = g;
+        for (auto& s : shards_)
+            push(*s, j);
+        return futur;
+    }
+
+    std::future<void> insert(int doc_id, gsl::span<const char*> text)
+    {
+        job_t j;
+        j.op          = request_t::insert;
+        j.document_id = doc_id;
+        j.text        = text;
+        return write(j);
+    }
+
+    std::future<void> remove(int doc_id)
+    {
+        job_t j;
+        j.op          = request_t::remove;
+        j.document_id = doc_id;
+        return write(j);
+    }
+
+    int n_shards() const
+    {
+        return int(shards_.size());
+    }
+
+private:
+    // Searches merged from every shard
+    struct gather_t
+    {
+        std::promise<result_t> p;
+        std::atomic<int>       remaining;
+        std::mutex             m;
+        result_t               r;
+    };
+
+    struct job_t
+    {
+        request_t::op_t        op;
+        const char*            word        = nullptr; // search
+        int                    document_id = 0;       // insert, remove
+        gsl::span<const char*> text;                  // insert
+        gather_t*              gather      = nullptr; // search
+        std::promise<void>*    done        = nullptr; // insert, remove
+    };
+
+    struct shard_t
+    {
+        explicit shard_t(std::size_t ring_size)
+            : ring(ring_size)
+        {}
+
+        DICTIONARY  dic;
+        Ring<job_t> ring;
+        std::thread worker;
+
+        std::mutex              m; // To lock when sleeping or waking the worker up
+        std::condition_variable cv;
+        std::atomic<bool>       sleeping{false};
+        bool                    stop = false;
+    };
+
+    std::size_t shard_of(int doc_id) const
+    {
+        return unsigned(doc_id) % shards_.size();
+    }
+
+    std::future<void> write(job_t& j)
+    {
+        j.done = new std::promise<void>;
+        auto futur = j.done->get_future();
+        push(*shards_[shard_of(j.document_id)], j);
+        return futur;
+    }
+
+    static void push(shard_t& s, const job_t& j)
+    {
+        while (!s.ring.try_push(j))
+            std::this_thread::yield();
+
+        // Either the worker going to sleep sees j in the ring, or it is seen sleeping here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s.sleeping.load(std::memory_order_relaxed))
+        {
+            std::lock_guard l(s.m);
+            s.cv.notify_one();
+        }
+    }
+
+    static void work(shard_t& s)
+    {
+        job_t j;
+        int idle = 0;
+        while (true)
+        {
+            if (s.ring.try_pop(j))
+            {
+                execute(s, j);
+                idle = 0;
+            }
+            else if (++idle < SPINS)
+                std::this_thread::yield();
+            else
+            {
+                std::unique_lock l(s.m);
+                s.sleeping = true;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                s.cv.wait(l, [&s] { return s.stop || !s.ring.empty(); });
+                s.sleeping = false;
+                if (s.stop && s.ring.empty())
+                    return;
+                idle = 0;
+            }
+        }
+    }
+
+    static void execute(shard_t& s, const job_t& j)
+    {
+        switch (j.op)
+        {
+        case request_t::search:
+        {
+            const result_t r = s.dic.search(j.word);
+            {
+                std::lock_guard l(j.gather->m);
+                merge_results(j.gather->r, r);
+            }
+            if (j.gather->remaining.fetch_sub(1) == 1)
+            {
+                j.gather->p.set_value(j.gather->r);
+                delete j.gather;
+            }
+            return;
+        }
+        case request_t::insert: s.dic.insert(j.document_id, j.text); break;
+        case request_t::remove: s.dic.remove(j.document_id); break;
+        }
+        j.done->set_value();
+        delete j.done;
+    }
+
+    std::vector<std::unique_ptr<shard_t>> shards_;
+};
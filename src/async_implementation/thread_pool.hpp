@@ -1,27 +1,243 @@
 #pragma once
 
 #include <tbb/tbb.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
 #include <vector>
-#include <iostream>
 
+#include "affinity.hpp"
+
+/// Configuration of the workers of a Thread_Pool
+struct executor_config_t
+{
+    int              read_workers  = 0;     // 0 for the TBB concurrency minus the write workers
+    int              write_workers = 0;     // 0 for 1/4 of the TBB concurrency
+    std::vector<int> cpus;                  // CPUs to pin the workers to, empty to leave them free
+    bool             isolated      = false; // Run on threads of the pool, not on the TBB workers of the process
+};
+
+/// Pin the threads entering an arena to some CPUs, in turn
+/// A TBB worker moves from arena to arena: its affinity is restored when it leaves.
+class Pinning_Observer : public tbb::task_scheduler_observer
+{
+public:
+    Pinning_Observer(tbb::task_arena& arena, std::vector<int> cpus)
+        : tbb::task_scheduler_observer(arena)
+        , cpus_(std::move(cpus))
+    {
+        observe(true);
+    }
+
+    ~Pinning_Observer()
+    {
+        observe(false);
+    }
+
+    void on_scheduler_entry(bool) override
+    {
+        saved() = this_thread_affinity();
+        pin_this_thread(cpus_[next_.fetch_add(1) % cpus_.size()]);
+    }
+
+    void on_scheduler_exit(bool) override
+    {
+        set_this_thread_affinity(saved());
+    }
+
+private:
+    static cpu_mask_t& saved()
+    {
+        static thread_local cpu_mask_t mask;
+        return mask;
+    }
+
+    std::vector<int>      cpus_;
+    std::atomic<unsigned> next_{0};
+};
+
+/// Workers running the tasks of one lane of a Thread_Pool
+/// Either a TBB arena, served by the TBB workers shared by the process, or threads
+/// of its own if isolated.
+class Lane
+{
+public:
+    Lane(int workers, std::vector<int> cpus, bool isolated)
+        : arena_(workers, 0)
+    {
+        if (isolated)
+        {
+            for (int i = 0; i < workers; ++i)
+            {
+                threads_.emplace_back([this] { serve(); });
+                if (!cpus.empty())
+                    pin_thread(threads_.back().native_handle(), cpus[i % cpus.size()]);
+            }
+        }
+        else if (!cpus.empty())
+            observer_ = std::make_unique<Pinning_Observer>(arena_, std::move(cpus));
+    }
+
+    ~Lane()
+    {
+        // An empty task stops a thread once the tasks queued before it are done
+        for (std::size_t i = 0; i < threads_.size(); ++i)
+            queue_.push({});
+        for (auto& t : threads_)
+            t.join();
+    }
+
+    template <typename T>
+    void enqueue(T&& t)
+    {
+        if (threads_.empty())
+            arena_.enqueue(std::forward<T>(t));
+        else
+            queue_.push(std::function<void()>(std::forward<T>(t)));
+    }
+
+private:
+    void serve()
+    {
+        std::function<void()> t;
+        while (true)
+        {
+            queue_.pop(t);
+            if (!t)
+                return;
+            t();
+        }
+    }
+
+    tbb::task_arena                                      arena_; // Initialized on its first task only
+    std::unique_ptr<Pinning_Observer>                    observer_;
+    tbb::concurrent_bounded_queue<std::function<void()>> queue_; // Tasks for the threads of the lane
+    std::vector<std::thread>                             threads_;
+};
+
+/// Workers split in a read lane and a write lane
+/// Each lane has its own workers, so a burst of writes does not queue ahead of
+/// the searches. Writes are queued and drained in batches by at most
+/// write_workers tasks at a time.
 class Thread_Pool
 {
 public:
-    Thread_Pool(/*int pool_size*/) : /*pools_(pool_size),*/ counter_(0) {}
+    static constexpr int WRITE_BATCH = 64; // Writes run by a drain task before it yields its thread
+
+    /// read_workers + write_workers defaults to the TBB concurrency, 1/4 of it for the writes
+    explicit Thread_Pool(int read_workers = 0, int write_workers = 0)
+        : Thread_Pool(executor_config_t{read_workers, write_workers, {}, false})
+    {}
+
+    /// The read lane is pinned to the first CPUs of config.cpus and the write lane to
+    /// the next ones, or both lanes share them if there are less CPUs than workers
+    explicit Thread_Pool(const executor_config_t& config)
+        : write_workers_(config.write_workers > 0 ? config.write_workers : default_write_workers())
+        , read_workers_(config.read_workers > 0 ? config.read_workers : default_read_workers(write_workers_))
+        , reads_(read_workers_, lane_cpus(config.cpus, 0, read_workers_), config.isolated)
+        , writes_(write_workers_, lane_cpus(config.cpus, read_workers_, write_workers_), config.isolated)
+    {}
 
     ~Thread_Pool()
     {
-        //for (size_t i = 0; i < pools_.size(); i++)
-            pools_/*[i]*/.wait();
+        wait();
     }
 
+    /// Run t in the read lane
     template <typename T>
     void push(T&& t)
     {
-        pools_/*[counter_++ % pools_.size()]*/.run(t);
+        pending_.fetch_add(1);
+        reads_.enqueue([this, t = std::forward<T>(t)]() {
+            t();
+            pending_.fetch_sub(1);
+        });
+    }
+
+    /// Queue t in the write lane
+    template <typename T>
+    void push_write(T&& t)
+    {
+        pending_.fetch_add(1);
+        write_queue_.push(std::function<void()>(std::forward<T>(t)));
+        start_drain();
+    }
+
+    int workers() const
+    {
+        return read_workers_ + write_workers_;
+    }
+
+    /// Wait for all the pushed tasks, and the drain tasks, to be done
+    void wait()
+    {
+        while (pending_.load() > 0)
+            std::this_thread::yield();
     }
 
 private:
-    /*std::vector<*/tbb::task_group/*>*/ pools_;
-    int counter_;
-};
\ No newline at end of file
+    static int default_write_workers()
+    {
+        return std::max(1, tbb::this_task_arena::max_concurrency() / 4);
+    }
+
+    static int default_read_workers(int write_workers)
+    {
+        return std::max(1, tbb::this_task_arena::max_concurrency() - write_workers);
+    }
+
+    static std::vector<int> lane_cpus(const std::vector<int>& cpus, int first, int count)
+    {
+        if (cpus.size() < std::size_t(first + count))
+            return cpus;
+        return {cpus.begin() + first, cpus.begin() + first + count};
+    }
+
+    // Start a drain task if less than write_workers_ are running
+    void start_drain()
+    {
+        int n = draining_.load();
+        while (n < write_workers_)
+        {
+            if (draining_.compare_exchange_weak(n, n + 1))
+            {
+                pending_.fetch_add(1); // Done when the drain task returns
+                writes_.enqueue([this] { drain(); });
+                return;
+            }
+        }
+    }
+
+    void drain()
+    {
+        std::function<void()> write;
+        for (int i = 0; i < WRITE_BATCH; ++i)
+        {
+            if (!write_queue_.try_pop(write))
+            {
+                draining_.fetch_sub(1);
+                // A write pushed after the try_pop may have seen this task still draining
+                if (!write_queue_.empty())
+                    start_drain();
+                pending_.fetch_sub(1); // Last access to the pool
+                return;
+            }
+            write();
+            pending_.fetch_sub(1);
+        }
+
+        // Batch done: give the thread back to the lane, then go on in a new task
+        writes_.enqueue([this] { drain(); });
+    }
+
+    const int write_workers_;
+    const int read_workers_;
+    Lane      reads_;
+    Lane      writes_;
+
+    tbb::concurrent_queue<std::function<void()>> write_queue_;
+    std::atomic<int>                             draining_{0}; // Running drain tasks
+    std::atomic<long>                            pending_{0};  // Pushed tasks not done yet
+};
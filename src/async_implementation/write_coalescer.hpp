@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../IDictionary.hpp"
+#include "async_stats.hpp"
+#include "thread_pool.hpp"
+
+/// Writes waiting to be applied, coalesced per document
+/// The writes of a document are applied one at a time, in order. While they wait,
+/// they are reduced to at most a remove then an insert: a remove cancels the writes
+/// before it, and an insert after another one is dropped since it would do nothing.
+/// The future of every write is set once the reduced writes are applied.
+template <typename DICTIONARY>
+class Write_Coalescer
+{
+public:
+    // A write waiting for its future to be set
+    struct waiter_t
+    {
+        std::promise<void>*                        p;
+        std::int64_t                               submitted = 0; // stats_clock()
+        std::shared_ptr<std::atomic<std::int64_t>> done;          // Completion time, if traced
+    };
+
+    /// The writes are timed in stats if not null
+    Write_Coalescer(DICTIONARY& dic, Thread_Pool& pool, Async_Stats* stats = nullptr)
+        : dic_(dic)
+        , pool_(pool)
+        , stats_(stats)
+    {}
+
+    void insert(int doc_id, gsl::span<const char*> text, std::promise<void>* done)
+    {
+        insert(doc_id, text, waiter_t{done, stats_clock(), nullptr});
+    }
+
+    void remove(int doc_id, std::promise<void>* done)
+    {
+        remove(doc_id, waiter_t{done, stats_clock(), nullptr});
+    }
+
+    void insert(int doc_id, gsl::span<const char*> text, waiter_t done)
+    {
+        std::lock_guard l(m_);
+        doc_writes_t& d = docs_[doc_id];
+        if (!d.queued.insert)
+        {
+            d.queued.insert = true;
+            d.queued.text   = text;
+        }
+        queue(doc_id, d, request_t::insert, std::move(done));
+    }
+
+    void remove(int doc_id, waiter_t done)
+    {
+        std::lock_guard l(m_);
+        doc_writes_t& d = docs_[doc_id];
+        d.queued.remove = true;
+        d.queued.insert = false;
+        queue(doc_id, d, request_t::remove, std::move(done));
+    }
+
+    /// Writes submitted and writes applied to the dictionary
+    std::size_t submitted() const { return submitted_; }
+    std::size_t applied() const { return applied_; }
+
+    /// Writes whose future is not set yet
+    std::size_t pending() const { return pending_; }
+
+private:
+    // Writes of a document reduced to: remove if remove, then insert text if insert
+    struct write_t
+    {
+        bool                             remove = false;
+        bool                             insert = false;
+        gsl::span<const char*>           text;
+        std::vector<std::pair<request_t::op_t, waiter_t>> done;
+    };
+
+    struct doc_writes_t
+    {
+        write_t queued;
+        bool    scheduled = false; // A task will apply queued
+        bool    running   = false; // Writes of the document are being applied
+    };
+
+    // Under m_
+    void queue(int doc_id, doc_writes_t& d, request_t::op_t op, waiter_t done)
+    {
+        d.queued.done.emplace_back(op, std::move(done));
+        ++submitted_;
+        ++pending_;
+        if (!d.scheduled && !d.running)
+            schedule(doc_id, d);
+    }
+
+    // Under m_
+    void schedule(int doc_id, doc_writes_t& d)
+    {
+        d.scheduled = true;
+        pool_.push_write([this, doc_id] { apply(doc_id); });
+    }
+
+    void apply(int doc_id)
+    {
+        write_t w;
+        {
+            std::lock_guard l(m_);
+            doc_writes_t& d = docs_[doc_id];
+            std::swap(w, d.queued);
+            d.scheduled = false;
+            d.running   = true;
+            applied_ += w.remove + w.insert;
+        }
+
+        const std::int64_t start = stats_clock();
+        if (w.remove)
+            dic_.remove(doc_id);
+        const std::int64_t removed = stats_clock();
+        if (w.insert)
+            dic_.insert(doc_id, w.text);
+        const std::int64_t end = stats_clock();
+
+        if (stats_ != nullptr)
+        {
+            if (w.remove)
+                stats_->record(request_t::remove, phase::execution, removed - start);
+            if (w.insert)
+                stats_->record(request_t::insert, phase::execution, end - removed);
+            for (auto& [op, waiter] : w.done)
+                stats_->record(op, phase::queued, start - waiter.submitted);
+        }
+
+        for (auto& [op, waiter] : w.done)
+        {
+            if (waiter.done)
+                waiter.done->store(end);
+            waiter.p->set_value();
+            delete waiter.p;
+        }
+        pending_ -= w.done.size();
+
+        std::lock_guard l(m_);
+        doc_writes_t& d = docs_[doc_id];
+        d.running = false;
+        if (!d.queued.done.empty())
+            schedule(doc_id, d);
+        else
+            docs_.erase(doc_id);
+    }
+
+    DICTIONARY&  dic_;
+    Thread_Pool& pool_;
+    Async_Stats* stats_;
+
+    std::mutex                            m_;
+    std::unordered_map<int, doc_writes_t> docs_; // Documents with writes not applied yet
+    std::atomic<std::size_t>              submitted_{0};
+    std::atomic<std::size_t>              applied_{0};
+    std::atomic<std::size_t>              pending_{0};
+};
@@ -1,13 +1,28 @@
+#include <algorithm>
+#include <chrono>
 #include <benchmark/benchmark.h>
+#include <cstring>
 #include <functional>
+#include <shared_mutex>
+#include <thread>
 
 #include "hashmap_implementation/hashmap_dictionary.hpp"
 #include "naive_implementation/naive_async_dictionary.hpp"
 #include "naive_implementation/naive_dictionary.hpp"
+#include "tokenizer.hpp"
 #include "tools.hpp"
 #include "trie_implementation/tree_dictionary.hpp"
 #include "async_implementation/async_dictionary.hpp"
+#include "async_implementation/queued_dictionary.hpp"
+#include "async_implementation/awaitable_dictionary.hpp"
+#include "async_implementation/shard_affine_dictionary.hpp"
 #include "fusion_implementation/fusion_dictionary.hpp"
+#include "policy_implementation/policy_dictionary.hpp"
+#include "sharded_implementation/sharded_dictionary.hpp"
+#include "mvcc_implementation/mvcc_dictionary.hpp"
+#include "left_right_implementation/left_right_dictionary.hpp"
+#include "lsm_implementation/lsm_dictionary.hpp"
+#include "adaptive_implementation/adaptive_dictionary.hpp"
 
 class BMScenario : public ::benchmark::Fixture
 {
@@ -23,6 +38,7 @@ public:
             params.word_occupancy   = 0.9f;
             params.n_queries        = 1000000;
             params.ratio_indel      = 0.2;
+            params.n_typos          = 10000;
 
             m_scenario = std::make_unique<Scenario>(params);
         }
@@ -78,6 +94,267 @@ BENCHMARK_DEFINE_F(BMScenario, Hashmap_NoAsync)(benchmark::State& st)
     st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
 }
 
+BENCHMARK_DEFINE_F(BMScenario, Tree_Fuzzy)(benchmark::State& st)
+{
+    Tree_Dictionary dic;
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        for (const auto& word : m_scenario->typos())
+            benchmark::DoNotOptimize(dic.search_fuzzy(word.c_str(), st.range(0)));
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->typos().size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Fuzzy)(benchmark::State& st)
+{
+    Fusion_Dictionary dic;
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        for (const auto& word : m_scenario->typos())
+            benchmark::DoNotOptimize(dic.search_fuzzy(word.c_str(), st.range(0)));
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->typos().size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Search)(benchmark::State& st)
+{
+    Tree_Dictionary dic;
+    m_scenario->prepare(dic);
+    const auto words = m_scenario->searches();
+
+    for (auto _ : st)
+        for (const char* word : words)
+            benchmark::DoNotOptimize(dic.search(word));
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+    st.counters["bytes"] = dic.root_.memory_usage();
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Frozen_Search)(benchmark::State& st)
+{
+    Tree_Dictionary dic;
+    m_scenario->prepare(dic);
+    const auto frozen = dic.freeze();
+    const auto words = m_scenario->searches();
+
+    for (auto _ : st)
+        for (const char* word : words)
+            benchmark::DoNotOptimize(frozen.search(word));
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+    st.counters["bytes"] = frozen.memory_usage();
+}
+
+// Searches of the words of range(0) letters
+template <class D>
+static void search_length(const Scenario& scenario, benchmark::State& st)
+{
+    D dic;
+    scenario.prepare(dic);
+    auto words = scenario.searches();
+    words.erase(std::remove_if(words.begin(), words.end(),
+                               [&st](const char* w) { return std::strlen(w) != std::size_t(st.range(0)); }),
+                words.end());
+
+    for (auto _ : st)
+        for (const char* word : words)
+            benchmark::DoNotOptimize(dic.search(word));
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Search_Length)(benchmark::State& st)
+{
+    search_length<Tree_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Search_Length)(benchmark::State& st)
+{
+    search_length<Fusion_Dictionary>(*m_scenario, st);
+}
+
+// Searches run by batches of range(0) words, one at a time for 1
+template <class D>
+static void search_batch(const Scenario& scenario, benchmark::State& st)
+{
+    D dic;
+    scenario.prepare(dic);
+    const auto        words = scenario.searches();
+    const std::size_t batch = std::size_t(st.range(0));
+    std::vector<result_t> out(batch);
+
+    for (auto _ : st)
+    {
+        if (batch == 1)
+            for (const char* word : words)
+                benchmark::DoNotOptimize(dic.search(word));
+        else
+            for (std::size_t i = 0; i < words.size(); i += batch)
+            {
+                const std::size_t n = std::min(batch, words.size() - i);
+                dic.search_batch(gsl::make_span(words.data() + i, n), gsl::make_span(out.data(), n));
+                benchmark::DoNotOptimize(out.data());
+            }
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Search_Batch)(benchmark::State& st)
+{
+    search_batch<Tree_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Search_Batch)(benchmark::State& st)
+{
+    search_batch<Fusion_Dictionary>(*m_scenario, st);
+}
+
+// Searches of the 1000 first searched words, looked up each time for range(0) == 0,
+// or prepared once
+template <class D>
+static void search_prepared(const Scenario& scenario, benchmark::State& st)
+{
+    D dic;
+    scenario.prepare(dic);
+    auto words = scenario.searches();
+    words.resize(std::min<std::size_t>(words.size(), 1000));
+    std::vector<prepared_t> handles;
+    for (const char* word : words)
+        handles.push_back(dic.prepare(word));
+
+    for (auto _ : st)
+    {
+        if (st.range(0) == 0)
+            for (const char* word : words)
+                benchmark::DoNotOptimize(dic.search(word));
+        else
+            for (const prepared_t& q : handles)
+                benchmark::DoNotOptimize(dic.search_prepared(q));
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Prepared)(benchmark::State& st)
+{
+    search_prepared<Tree_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Prepared)(benchmark::State& st)
+{
+    search_prepared<Fusion_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Hashmap_Prepared)(benchmark::State& st)
+{
+    search_prepared<hashmap_dictionary>(*m_scenario, st);
+}
+
+// Searches of a Dictionary called directly for range(0) == 0, through
+// IReversedDictionary otherwise
+template <class D>
+static void policy_search(const Scenario& scenario, benchmark::State& st)
+{
+    Virtual_Dictionary<D> dic;
+    scenario.prepare(dic);
+    const IReversedDictionary& virtual_dic = dic;
+    const auto words = scenario.searches();
+
+    for (auto _ : st)
+    {
+        if (st.range(0) == 0)
+            for (const char* word : words)
+                benchmark::DoNotOptimize(dic.get().search(word));
+        else
+            for (const char* word : words)
+                benchmark::DoNotOptimize(virtual_dic.search(word));
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Policy_Trie_Vector_Shared)(benchmark::State& st)
+{
+    policy_search<Trie_Policy_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Policy_Trie_Head_Spin)(benchmark::State& st)
+{
+    policy_search<Dictionary<Trie_Index, Head_Postings, Spin_Policy>>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Policy_Hash_Vector_Shared)(benchmark::State& st)
+{
+    policy_search<Hash_Policy_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Policy_Hash_Head_Spin)(benchmark::State& st)
+{
+    policy_search<Dictionary<Hash_Index, Head_Postings, Spin_Policy>>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Policy_Map_Vector_Shared)(benchmark::State& st)
+{
+    policy_search<Naive_Policy_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tokenize)(benchmark::State& st)
+{
+    const auto texts = m_scenario->raw_texts();
+    std::vector<char> buffer;
+    std::vector<const char*> words;
+
+    std::size_t bytes = 0;
+    for (const auto& raw : texts)
+        bytes += raw.size();
+
+    for (auto _ : st)
+        for (const auto& raw : texts)
+        {
+            tokenize(raw, buffer, words);
+            benchmark::DoNotOptimize(words.data());
+        }
+
+    st.SetBytesProcessed(st.iterations() * bytes);
+}
+
+// Insertion of the raw documents in an empty dictionary
+template <class D>
+static void insert_text(const Scenario& scenario, benchmark::State& st)
+{
+    const auto texts = scenario.raw_texts();
+
+    std::size_t bytes = 0;
+    for (const auto& raw : texts)
+        bytes += raw.size();
+
+    for (auto _ : st)
+    {
+        auto dic = std::make_unique<D>();
+        for (std::size_t i = 0; i < texts.size(); ++i)
+            dic->insert_text(int(i), texts[i]);
+
+        st.PauseTiming();
+        dic.reset();
+        st.ResumeTiming();
+    }
+
+    st.SetBytesProcessed(st.iterations() * bytes);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Insert_Text)(benchmark::State& st)
+{
+    insert_text<Tree_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Insert_Text)(benchmark::State& st)
+{
+    insert_text<Fusion_Dictionary>(*m_scenario, st);
+}
+
 BENCHMARK_DEFINE_F(BMScenario, Naive_Async)(benchmark::State& st)
 {
     naive_async_dictionary dic;
@@ -89,6 +366,21 @@ BENCHMARK_DEFINE_F(BMScenario, Naive_Async)(benchmark::State& st)
     st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
 }
 
+// Median and p99 of each phase of the searches, and busy ratio of the workers
+static void report_timings(benchmark::State& st, const async_stats_t& t)
+{
+    const char* names[] = {"queued", "exec", "handoff"};
+    for (auto p : {phase::queued, phase::execution, phase::handoff})
+    {
+        const histogram_t& h = t.of(request_t::search, p);
+        if (h.count == 0)
+            continue;
+        st.counters[std::string(names[int(p)]) + "_p50_us"] = double(h.quantile_ns(0.5)) / 1000;
+        st.counters[std::string(names[int(p)]) + "_p99_us"] = double(h.quantile_ns(0.99)) / 1000;
+    }
+    st.counters["busy"] = t.busy_ratio();
+}
+
 BENCHMARK_DEFINE_F(BMScenario, Hashmap_Async)(benchmark::State& st)
 {
     Async_Dictionary<hashmap_dictionary> dic;
@@ -98,6 +390,7 @@ BENCHMARK_DEFINE_F(BMScenario, Hashmap_Async)(benchmark::State& st)
         m_scenario->execute(dic);
 
     st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+    report_timings(st, dic.timings());
 }
 
 BENCHMARK_DEFINE_F(BMScenario, Tree_Async)(benchmark::State& st)
@@ -109,6 +402,7 @@ BENCHMARK_DEFINE_F(BMScenario, Tree_Async)(benchmark::State& st)
         m_scenario->execute(dic);
 
     st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+    report_timings(st, dic.timings());
 }
 
 BENCHMARK_DEFINE_F(BMScenario, Fusion_Async)(benchmark::State& st)
@@ -116,12 +410,482 @@ BENCHMARK_DEFINE_F(BMScenario, Fusion_Async)(benchmark::State& st)
     Async_Dictionary<Fusion_Dictionary> dic;
     m_scenario->prepare(dic);
 
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+    report_timings(st, dic.timings());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Async_Traced)(benchmark::State& st)
+{
+    Async_Dictionary<Fusion_Dictionary> dic;
+    dic.trace_handoff(true);
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+    report_timings(st, dic.timings());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Queued)(benchmark::State& st)
+{
+    Queued_Dictionary<Tree_Dictionary> dic;
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Queued)(benchmark::State& st)
+{
+    Queued_Dictionary<Fusion_Dictionary> dic;
+    m_scenario->prepare(dic);
+
     for (auto _ : st)
         m_scenario->execute(dic);
 
     st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
 }
 
+// Searches in an empty dictionary, so that only the cost of the async layer remains
+BENCHMARK_DEFINE_F(BMScenario, Async_Overhead)(benchmark::State& st)
+{
+    Async_Dictionary<Tree_Dictionary> dic;
+    const auto words = m_scenario->searches();
+    std::vector<std::future<result_t>> in_flight(st.range(0));
+
+    for (auto _ : st)
+        for (std::size_t i = 0; i < words.size(); ++i)
+        {
+            auto& f = in_flight[i % in_flight.size()];
+            if (f.valid())
+                benchmark::DoNotOptimize(f.get());
+            f = dic.search(words[i]);
+        }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Queued_Overhead)(benchmark::State& st)
+{
+    Queued_Dictionary<Tree_Dictionary> dic;
+    const auto words = m_scenario->searches();
+    Completion_Queue cq(st.range(0));
+    std::vector<response_t> reaped(cq.capacity());
+
+    for (auto _ : st)
+    {
+        std::size_t in_flight = 0;
+        for (std::size_t i = 0; i < words.size(); ++i)
+        {
+            if (in_flight == std::size_t(st.range(0)))
+                in_flight -= cq.wait(reaped.data(), reaped.size());
+
+            request_t r;
+            r.op   = request_t::search;
+            r.tag  = i;
+            r.cq   = &cq;
+            r.word = words[i];
+            while (!dic.submit(r))
+                in_flight -= cq.reap(reaped.data(), reaped.size());
+            ++in_flight;
+        }
+        while (in_flight > 0)
+            in_flight -= cq.wait(reaped.data(), reaped.size());
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+// Shared index against one shard per worker, for st.range(0) workers
+BENCHMARK_DEFINE_F(BMScenario, Async_Scaling)(benchmark::State& st)
+{
+    const int n = int(st.range(0));
+    Async_Dictionary<Fusion_Dictionary> dic(n, std::max(1, n / 4));
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Shard_Affine_Scaling)(benchmark::State& st)
+{
+    Shard_Affine_Dictionary<Fusion_Dictionary> dic(int(st.range(0)));
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+}
+
+// Searches from all the TBB workers, with a writer inserting and removing
+// documents meanwhile, on range(0) shards searched in parallel if range(1)
+template <class D>
+static void sharded_scaling(const Scenario& scenario, benchmark::State& st)
+{
+    Sharded_Dictionary<D> dic(int(st.range(0)), st.range(1) != 0);
+    scenario.prepare(dic);
+    const auto words = scenario.searches();
+    const auto texts = scenario.raw_texts();
+
+    for (auto _ : st)
+    {
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (std::size_t i = 0; !done; i = (i + 1) % texts.size())
+            {
+                dic.remove(int(i));
+                dic.insert_text(int(i), texts[i]);
+            }
+        });
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, words.size(), 1024), [&](const auto& r) {
+            for (std::size_t i = r.begin(); i != r.end(); ++i)
+                benchmark::DoNotOptimize(dic.search(words[i]));
+        });
+        done = true;
+        writer.join();
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Hashmap_Sharded)(benchmark::State& st)
+{
+    sharded_scaling<hashmap_dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Tree_Sharded)(benchmark::State& st)
+{
+    sharded_scaling<Tree_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Sharded)(benchmark::State& st)
+{
+    sharded_scaling<Fusion_Dictionary>(*m_scenario, st);
+}
+
+// Consistent views of 4 searches from all the TBB workers, while a thread removes
+// and inserts documents: under a global lock for range(0) == 0, from an MVCC
+// snapshot otherwise
+BENCHMARK_DEFINE_F(BMScenario, Consistent_Views)(benchmark::State& st)
+{
+    constexpr std::size_t VIEW = 4;
+    Fusion_Dictionary locked_dic;
+    std::shared_mutex global;
+    Mvcc_Dictionary<> mvcc_dic;
+    const bool mvcc = st.range(0) != 0;
+    IReversedDictionary& dic = mvcc ? static_cast<IReversedDictionary&>(mvcc_dic) : locked_dic;
+    m_scenario->prepare(dic);
+    const auto words = m_scenario->searches();
+    const auto texts = m_scenario->raw_texts();
+    std::size_t writes = 0;
+
+    for (auto _ : st)
+    {
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (std::size_t i = 0; !done; i = (i + 1) % texts.size(), writes += 2)
+            {
+                std::unique_lock l(global, std::defer_lock);
+                if (!mvcc)
+                    l.lock();
+                dic.remove(int(i));
+                dic.insert_text(int(i), texts[i]);
+            }
+        });
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, words.size() / VIEW, 256), [&](const auto& r) {
+            for (std::size_t i = r.begin(); i != r.end(); ++i)
+            {
+                if (mvcc)
+                {
+                    const auto s = mvcc_dic.snapshot();
+                    for (std::size_t j = 0; j < VIEW; ++j)
+                        benchmark::DoNotOptimize(s.search(words[i * VIEW + j]));
+                }
+                else
+                {
+                    std::shared_lock l(global);
+                    for (std::size_t j = 0; j < VIEW; ++j)
+                        benchmark::DoNotOptimize(locked_dic.search(words[i * VIEW + j]));
+                }
+            }
+        });
+        done = true;
+        writer.join();
+    }
+
+    st.SetItemsProcessed(st.iterations() * (words.size() / VIEW) * VIEW);
+    st.counters["writes"] = benchmark::Counter(double(writes), benchmark::Counter::kIsRate);
+}
+
+// Searches from range(0) threads, with 1 write for 1000 searches
+template <class D>
+static void read_scaling(const Scenario& scenario, benchmark::State& st)
+{
+    D dic;
+    scenario.prepare(dic);
+    const auto words = scenario.searches();
+    const auto texts = scenario.raw_texts();
+    tbb::task_arena arena(int(st.range(0)), 0);
+
+    for (auto _ : st)
+        arena.execute([&] {
+            tbb::parallel_for(tbb::blocked_range<std::size_t>(0, words.size(), 1024), [&](const auto& r) {
+                for (std::size_t i = r.begin(); i != r.end(); ++i)
+                {
+                    if (i % 1000 == 0)
+                    {
+                        const int doc = int(i / 1000 % texts.size());
+                        dic.remove(doc);
+                        dic.insert_text(doc, texts[doc]);
+                    }
+                    else
+                        benchmark::DoNotOptimize(dic.search(words[i]));
+                }
+            });
+        });
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Read_Scaling)(benchmark::State& st)
+{
+    read_scaling<Fusion_Dictionary>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Left_Right_Fusion)(benchmark::State& st)
+{
+    read_scaling<Left_Right_Dictionary<Fusion_Dictionary>>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Left_Right_No_Lock)(benchmark::State& st)
+{
+    read_scaling<Left_Right_Dictionary<Dictionary<Trie_Index, Head_Postings, No_Lock_Policy>>>(*m_scenario, st);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Lsm_Read_Scaling)(benchmark::State& st)
+{
+    read_scaling<Lsm_Dictionary>(*m_scenario, st);
+}
+
+// A read-only phase then one with a write for 10 operations
+// Arg 0 adapts every Adaptive_Dictionary::MIN_WINDOW operations, 1 to 3 stay on hashmap, tree, fusion.
+// The documents of the shared scenario take seconds to migrate, more than a phase lasts.
+BENCHMARK_DEFINE_F(BMScenario, Adaptive_Phases)(benchmark::State& st)
+{
+    using engine_t = Adaptive_Dictionary::engine_t;
+    constexpr std::size_t PHASE = 1000000;
+    const engine_t engines[] = {engine_t::fusion, engine_t::hashmap, engine_t::tree, engine_t::fusion};
+
+    static std::unique_ptr<Scenario> scenario;
+    if (!scenario)
+    {
+        Scenario::param_t params = m_scenario->params();
+        params.n_queries        = 20000;
+        params.word_redoundancy = 0.01f;
+        scenario                = std::make_unique<Scenario>(params);
+    }
+
+    Adaptive_Dictionary dic(engines[st.range(0)], std::chrono::milliseconds(0));
+    scenario->prepare(dic);
+    const auto words = scenario->searches();
+    const auto texts = scenario->raw_texts();
+    const auto step = [&](std::size_t i) {
+        if (st.range(0) == 0 && i % Adaptive_Dictionary::MIN_WINDOW == 0)
+            dic.adapt();
+    };
+
+    for (auto _ : st)
+    {
+        for (std::size_t i = 0; i < PHASE; ++i)
+        {
+            benchmark::DoNotOptimize(dic.search(words[i % words.size()]));
+            step(i);
+        }
+        for (std::size_t i = 0; i < PHASE; ++i)
+        {
+            if (i % 10 != 0)
+                benchmark::DoNotOptimize(dic.search(words[i % words.size()]));
+            else
+            {
+                const int doc = int(i / 10 % texts.size());
+                dic.remove(doc);
+                dic.insert_text(doc, texts[doc]);
+            }
+            step(i);
+        }
+    }
+
+    st.SetItemsProcessed(st.iterations() * 2 * PHASE);
+    st.counters["migrations"] = dic.migrations();
+}
+
+// Isolated workers pinned to the first st.range(0) CPUs, one of them for the writes
+BENCHMARK_DEFINE_F(BMScenario, Async_Pinned)(benchmark::State& st)
+{
+    executor_config_t config;
+    config.read_workers = std::max(1, int(st.range(0)) - 1);
+    config.write_workers = 1;
+    config.isolated = true;
+    for (int cpu = 0; cpu < st.range(0); ++cpu)
+        config.cpus.push_back(cpu);
+
+    Async_Dictionary<Fusion_Dictionary> dic(config);
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+    st.counters["per_core"] = benchmark::Counter(double(st.iterations() * m_scenario->params().n_queries) / st.range(0),
+                                                 benchmark::Counter::kIsRate);
+}
+
+// Documents inserted, removed and inserted again before the writes are applied
+BENCHMARK_DEFINE_F(BMScenario, Async_Churn)(benchmark::State& st)
+{
+    constexpr int N_DOCS = 1000;
+    Async_Dictionary<Fusion_Dictionary> dic;
+    m_scenario->prepare(dic);
+    auto words = m_scenario->searches();
+    words.resize(std::min<std::size_t>(words.size(), 100));
+
+    std::vector<std::future<void>> writes;
+    for (auto _ : st)
+    {
+        for (int doc = 1 << 20; doc < (1 << 20) + N_DOCS; ++doc)
+        {
+            writes.push_back(dic.insert(doc, words));
+            writes.push_back(dic.remove(doc));
+            writes.push_back(dic.insert(doc, words));
+            writes.push_back(dic.insert(doc, words));
+        }
+        for (auto& w : writes)
+            w.get();
+        writes.clear();
+    }
+
+    st.SetItemsProcessed(st.iterations() * 4 * N_DOCS);
+    st.counters["applied"] = double(dic.writes().applied()) / double(dic.writes().submitted());
+}
+
+// Every search submitted at once to queues of 1024, with the policy st.range(0)
+BENCHMARK_DEFINE_F(BMScenario, Async_Overload)(benchmark::State& st)
+{
+    admission_config_t admission;
+    admission.max_reads = 1024;
+    admission.policy = overload_policy(st.range(0));
+    Async_Dictionary<Fusion_Dictionary> dic(executor_config_t{}, admission);
+    m_scenario->prepare(dic);
+    const auto words = m_scenario->searches();
+
+    std::vector<std::future<result_t>> searches;
+    std::size_t max_depth = 0;
+    for (auto _ : st)
+    {
+        for (auto w : words)
+        {
+            searches.push_back(dic.search(w));
+            max_depth = std::max(max_depth, dic.stats().read_depth);
+        }
+        for (auto& f : searches)
+            f.wait();
+        searches.clear();
+    }
+
+    const auto stats = dic.stats();
+    st.SetItemsProcessed(st.iterations() * words.size());
+    st.counters["failed"] = double(stats.rejected + stats.dropped) / double(st.iterations() * words.size());
+    st.counters["max_depth"] = double(max_depth);
+}
+
+// Latency of the searches issued during a burst of large inserts
+BENCHMARK_DEFINE_F(BMScenario, Async_Read_Latency)(benchmark::State& st)
+{
+    constexpr int BURST = 64;
+    Async_Dictionary<Tree_Dictionary> dic;
+    m_scenario->prepare(dic);
+    auto words = m_scenario->searches();
+    words.resize(std::min<std::size_t>(words.size(), 1000));
+
+    std::vector<double> latencies;
+    std::vector<std::future<void>> writes;
+    int doc_id = 1 << 20;
+    for (auto _ : st)
+    {
+        for (int i = 0; i < BURST; ++i)
+            writes.push_back(dic.insert(doc_id++, words));
+        for (auto w : words)
+        {
+            auto start = std::chrono::steady_clock::now();
+            benchmark::DoNotOptimize(dic.search(w).get());
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        for (auto& w : writes)
+            w.get();
+        writes.clear();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    st.counters["p50_us"] = latencies[latencies.size() / 2];
+    st.counters["p99_us"] = latencies[latencies.size() * 99 / 100];
+}
+
+#if defined(__cpp_impl_coroutine)
+BENCHMARK_DEFINE_F(BMScenario, Tree_Awaitable)(benchmark::State& st)
+{
+    Awaitable_Dictionary<Tree_Dictionary> dic;
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Fusion_Awaitable)(benchmark::State& st)
+{
+    Awaitable_Dictionary<Fusion_Dictionary> dic;
+    m_scenario->prepare(dic);
+
+    for (auto _ : st)
+        m_scenario->execute(dic);
+
+    st.SetItemsProcessed(st.iterations() * m_scenario->params().n_queries);
+}
+
+static Task search_all(const IAwaitableReversedDictionary& dic, const std::vector<const char*>& words,
+                       std::size_t first, std::size_t step)
+{
+    for (std::size_t i = first; i < words.size(); i += step)
+        benchmark::DoNotOptimize(co_await dic.search(words[i]));
+}
+
+BENCHMARK_DEFINE_F(BMScenario, Awaitable_Overhead)(benchmark::State& st)
+{
+    Awaitable_Dictionary<Tree_Dictionary> dic;
+    const auto words = m_scenario->searches();
+
+    for (auto _ : st)
+    {
+        Scheduler scheduler;
+        for (int c = 0; c < st.range(0); ++c)
+            scheduler.spawn(search_all(dic, words, c, st.range(0)));
+        scheduler.run();
+    }
+
+    st.SetItemsProcessed(st.iterations() * words.size());
+}
+#endif
+
 BENCHMARK_REGISTER_F(BMScenario, Naive_NoAsync)
     ->Unit(benchmark::kMillisecond) //
     ->UseRealTime();
@@ -135,6 +899,80 @@ BENCHMARK_REGISTER_F(BMScenario, Fusion_NoAsync)
     ->Unit(benchmark::kMillisecond) //
     ->UseRealTime();
 
+BENCHMARK_REGISTER_F(BMScenario, Tree_Fuzzy)
+    ->Arg(1)->Arg(2) // max edits
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Fuzzy)
+    ->Arg(1)->Arg(2) // max edits
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
+BENCHMARK_REGISTER_F(BMScenario, Tree_Search)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Frozen_Search)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Tree_Search_Length)
+    ->DenseRange(4, 16, 4) // word length
+    ->Unit(benchmark::kMicrosecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Search_Length)
+    ->DenseRange(4, 16, 4) // word length
+    ->Unit(benchmark::kMicrosecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Tree_Search_Batch)
+    ->Arg(1)->Arg(16)->Arg(256) // batch
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Search_Batch)
+    ->Arg(1)->Arg(16)->Arg(256) // batch
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Tree_Prepared)
+    ->Arg(0)->Arg(1) // prepared
+    ->Unit(benchmark::kMicrosecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Prepared)
+    ->Arg(0)->Arg(1) // prepared
+    ->Unit(benchmark::kMicrosecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Hashmap_Prepared)
+    ->Arg(0)->Arg(1) // prepared
+    ->Unit(benchmark::kMicrosecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Policy_Trie_Vector_Shared)
+    ->Arg(0)->Arg(1) // virtual
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Policy_Trie_Head_Spin)
+    ->Arg(0)->Arg(1) // virtual
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Policy_Hash_Vector_Shared)
+    ->Arg(0)->Arg(1) // virtual
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Policy_Hash_Head_Spin)
+    ->Arg(0)->Arg(1) // virtual
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Policy_Map_Vector_Shared)
+    ->Arg(0)->Arg(1) // virtual
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
+BENCHMARK_REGISTER_F(BMScenario, Tokenize)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Tree_Insert_Text)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Insert_Text)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
 BENCHMARK_REGISTER_F(BMScenario, Naive_Async)
     ->Unit(benchmark::kMillisecond) //
     ->UseRealTime();
@@ -147,5 +985,95 @@ BENCHMARK_REGISTER_F(BMScenario, Tree_Async)
 BENCHMARK_REGISTER_F(BMScenario, Fusion_Async)
     ->Unit(benchmark::kMillisecond) //
     ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Async_Traced)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
+BENCHMARK_REGISTER_F(BMScenario, Tree_Queued)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Queued)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Async_Overhead)
+    ->Arg(256) // in flight
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Queued_Overhead)
+    ->Arg(256) // in flight
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
+BENCHMARK_REGISTER_F(BMScenario, Async_Scaling)
+    ->RangeMultiplier(2)->Range(1, 8) // workers
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Shard_Affine_Scaling)
+    ->RangeMultiplier(2)->Range(1, 8) // shards
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Hashmap_Sharded)
+    ->RangeMultiplier(2)->Ranges({{1, 8}, {0, 1}}) // shards, parallel
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Tree_Sharded)
+    ->RangeMultiplier(2)->Ranges({{1, 8}, {0, 1}}) // shards, parallel
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Sharded)
+    ->RangeMultiplier(2)->Ranges({{1, 8}, {0, 1}}) // shards, parallel
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Consistent_Views)
+    ->Arg(0)->Arg(1) // mvcc
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Read_Scaling)
+    ->RangeMultiplier(2)->Range(1, 8) // threads
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Left_Right_Fusion)
+    ->RangeMultiplier(2)->Range(1, 8) // threads
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Left_Right_No_Lock)
+    ->RangeMultiplier(2)->Range(1, 8) // threads
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Lsm_Read_Scaling)
+    ->RangeMultiplier(2)->Range(1, 8) // threads
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Adaptive_Phases)
+    ->DenseRange(0, 3) // adaptive, hashmap, tree, fusion
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Async_Pinned)
+    ->RangeMultiplier(2)->Range(1, 8) // cores
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Async_Churn)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Async_Overload)
+    ->DenseRange(0, 2) // block, reject, drop_oldest_read
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Async_Read_Latency)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+
+#if defined(__cpp_impl_coroutine)
+BENCHMARK_REGISTER_F(BMScenario, Tree_Awaitable)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Fusion_Awaitable)
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+BENCHMARK_REGISTER_F(BMScenario, Awaitable_Overhead)
+    ->Arg(256) // in flight
+    ->Unit(benchmark::kMillisecond) //
+    ->UseRealTime();
+#endif
 
 BENCHMARK_MAIN();
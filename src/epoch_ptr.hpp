@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Pointer to an object replaced from time to time, read without a lock
+///
+/// Readers count themselves in the read indicator of the current epoch while
+/// they use the object, as in Left_Right_Dictionary: two increments of a counter
+/// of their own. A replaced object is retired, and collect() frees it once the
+/// readers of both epochs are gone, so it is freed as soon as the searches that
+/// used it end, whatever the threads do afterwards.
+template <typename T>
+class Epoch_Ptr
+{
+public:
+    static constexpr int N_STRIPES = 64; // Counters per read indicator, threads beyond share them
+
+    /// The object as seen by a reader, valid until the reader is destroyed
+    class reader
+    {
+    public:
+        reader(const reader&)            = delete;
+        reader& operator=(const reader&) = delete;
+
+        ~reader()
+        {
+            readers_.fetch_sub(1);
+        }
+
+        const T* operator->() const
+        {
+            return ptr_;
+        }
+
+        const T& operator*() const
+        {
+            return *ptr_;
+        }
+
+        /// False if no object is stored
+        explicit operator bool() const
+        {
+            return ptr_ != nullptr;
+        }
+
+    private:
+        friend class Epoch_Ptr;
+
+        reader(std::atomic<long>& readers, const T* ptr)
+            : readers_(readers)
+            , ptr_(ptr)
+        {}
+
+        std::atomic<long>& readers_;
+        const T*           ptr_;
+    };
+
+    /// Count the calling thread in the readers and load the object
+    reader read() const
+    {
+        std::atomic<long>& mine = indicators_[epoch_.load()].stripes[stripe()].readers;
+        mine.fetch_add(1);
+        return reader(mine, ptr_.load());
+    }
+
+    /// The object for its writers, which must keep store() out meanwhile
+    const T* get() const
+    {
+        return ptr_.load(std::memory_order_relaxed);
+    }
+
+    /// Replace the object, the old one is freed by the next collect()
+    void store(std::shared_ptr<const T> next)
+    {
+        std::lock_guard l(m_);
+        ptr_.store(next.get());
+        if (owned_)
+            retired_.push_back(std::move(owned_));
+        owned_ = std::move(next);
+    }
+
+    /// Wait for the readers that may still use a retired object, then free them
+    /// Not to be called with a reader alive in the calling thread
+    void collect()
+    {
+        std::vector<std::shared_ptr<const T>> retired;
+        {
+            std::lock_guard l(m_);
+            retired.swap(retired_);
+        }
+        if (retired.empty())
+            return;
+
+        // New readers count themselves in the other indicator once it is empty,
+        // then the readers of the first one, which may have loaded a retired object, are waited for
+        std::lock_guard l(collect_m_);
+        const int epoch = epoch_.load();
+        wait_empty(indicators_[1 - epoch]);
+        epoch_.store(1 - epoch);
+        wait_empty(indicators_[epoch]);
+    }
+
+private:
+    struct read_indicator_t
+    {
+        struct alignas(64) stripe_t
+        {
+            std::atomic<long> readers{0};
+        };
+
+        bool empty() const
+        {
+            for (const auto& s : stripes)
+                if (s.readers.load() != 0)
+                    return false;
+            return true;
+        }
+
+        stripe_t stripes[N_STRIPES];
+    };
+
+    static unsigned stripe()
+    {
+        static std::atomic<unsigned> next{0};
+        thread_local const unsigned index = next++ % N_STRIPES;
+        return index;
+    }
+
+    static void wait_empty(const read_indicator_t& indicator)
+    {
+        while (!indicator.empty())
+            std::this_thread::yield();
+    }
+
+    std::atomic<const T*>                 ptr_{nullptr};
+    std::shared_ptr<const T>              owned_;   // Object of ptr_
+    std::vector<std::shared_ptr<const T>> retired_; // Replaced, not freed yet
+    std::mutex                            m_;       // To lock when storing
+    std::atomic<int>                      epoch_{0}; // Read indicator the readers count themselves in
+    mutable read_indicator_t              indicators_[2];
+    std::mutex                            collect_m_; // One collect() at a time
+};
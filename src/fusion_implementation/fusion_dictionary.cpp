@@ -1,7 +1,7 @@
 #include "fusion_dictionary.hpp"
 
 #include <algorithm>
-#include <unordered_set>
+#include <cstdint>
 
 #include "../IDictionary.hpp"
 
@@ -20,74 +20,52 @@ void Fusion_Dictionary::init(const dictionary_t& d)
 
 void Fusion_Dictionary::_init(const dictionary_t& d)
 {
-    for (const auto& [book, words] : d)
-        for (const auto& word : words)
-            _add_word(word, book);
-    root_._init_Sub_nodes(book_Sub_nodes_own_);
-}
-
-void Fusion_Dictionary::_add_word(const char* word, int book,
-                                std::shared_ptr<std::vector<std::shared_ptr<Sub_node>>> vect)
-{
-    Node* cur = &root_;
-    while (*word != '\0')
-    {
-        if ((*cur)[*word] == nullptr)
-        {
-            // If 2 threads enters in the if at the same time
-            // Can't use std::call_once cause this function maybe called
-            // multiple time
-            std::lock_guard(cur->m);
-            if ((*cur)[*word] == nullptr)
-                cur->add_child(*word);
-        }
-        cur = (*cur)[*word];
-        ++word;
-    }
-
-    cur->add_book(book);
-    vect->emplace_back(cur->get_Sub_node());
+    // Built in parallel without locks: init does not run along other operations
+    root_.build(Node::sorted_books(d), [this](Node* n, const char* w) {
+        words_.insert(w, n->sub_node());
+    });
+
+    root_.for_each_book_handles(arena_, [this](int book, const std::vector<std::uint32_t>& handles) {
+        // The handles of a book already indexed are all collected again
+        auto node = book_Sub_nodes_own_.find_node_locked(book);
+        if (node != nullptr)
+            arena_.release(*node->get_value());
+        else
+            node = book_Sub_nodes_own_.create_node(book);
+        *node->get_value() = arena_.store(handles);
+        node->get_mutex().unlock();
+    });
 }
 
 void Fusion_Dictionary::_add_word(const char* word, const int book)
 {
+    const char* w = word;
     Node* cur = &root_;
     // Here data race on array but on the array itself, since we are accessing the cells in a thread-safe manner
     // There is a data race on the array but not on the cell, the programm is thus working
 
     while (*word != '\0')
     {
-        if ((*cur)[*word] == nullptr)
-        {
-            // If 2 threads enters in the if at the same time, thread-safe
-            // Can't use std::call_once cause this function maybe called
-            // multiple times
-            std::lock_guard(cur->m);
-            if ((*cur)[*word] == nullptr)
-                cur->add_child(*word);
-        }
-        cur = (*cur)[*word];
+        cur = cur->get_or_add_child(*word);
         ++word;
     }
 
     cur->add_book(book);
+    words_.insert(w, cur->sub_node());
 }
 
 void Fusion_Dictionary::_search_word(const char* word, result_t& r) const
 {
-    const Node* cur = &root_;
-    const int len = strlen(word);
-    for (int i = 0; i < len; ++i)
+    // One probe instead of one node per letter: every word of the trie is indexed
+    // before its insertion returns
+    const Sub_node* sn = words_.find(word);
+    if (sn == nullptr)
     {
-        cur = (*cur)[word[i]];
-        if (cur == nullptr)
-        {
-            r.m_count = 0;
-            return;
-        }
+        r.m_count = 0;
+        return;
     }
 
-    cur->read_books(r);
+    sn->read_books(r);
 }
 
 result_t Fusion_Dictionary::search(const char* word) const
@@ -97,19 +75,77 @@ result_t Fusion_Dictionary::search(const char* word) const
     return r;
 }
 
+prepared_t Fusion_Dictionary::prepare(const char* word) const
+{
+    // The Sub_node of a word lives as long as the trie, even once its books are removed
+    const Sub_node* sn = words_.find(word);
+    if (sn == nullptr)
+        return {word, nullptr, 0};
+    return {word, sn->owner->get_Sub_node(), id_.value};
+}
+
+result_t Fusion_Dictionary::search_prepared(const prepared_t& q) const
+{
+    if (q.owner != id_.value)
+        return search(q.word.c_str());
+
+    result_t r;
+    static_cast<const Sub_node*>(q.location.get())->read_books(r);
+    return r;
+}
+
+void Fusion_Dictionary::search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const
+{
+    const Sub_node* found[Word_Index::BATCH];
+    for (std::size_t first = 0; first < words.size(); first += Word_Index::BATCH)
+    {
+        const std::size_t n = std::min(Word_Index::BATCH, words.size() - first);
+        words_.find_batch(words.data() + first, n, found);
+
+        for (std::size_t i = 0; i < n; ++i)
+            if (found[i] != nullptr)
+                __builtin_prefetch(found[i]);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (found[i] == nullptr)
+                out[first + i].m_count = 0;
+            else
+                found[i]->read_books(out[first + i]);
+        }
+    }
+}
+
+std::vector<completion_t> Fusion_Dictionary::search_prefix(const char* prefix, int limit) const
+{
+    return prefix_completions(root_, prefix, limit);
+}
+
+std::vector<completion_t> Fusion_Dictionary::search_fuzzy(const char* word, int max_edits, int limit) const
+{
+    return fuzzy_completions(root_, word, max_edits, limit);
+}
+
+Frozen_Dictionary Fusion_Dictionary::freeze() const
+{
+    return Frozen_Dictionary(root_);
+}
+
 void Fusion_Dictionary::insert(int document_id, gsl::span<const char*> text)
 {
     if (book_Sub_nodes_own_.find_node_unlocked(document_id) != nullptr)
         return;
 
-    auto s = std::unordered_set<const char*>();
-        for (const char* word : text)
-            s.emplace(word);
+    const auto words = Node::sorted_words(text);
 
     auto node = book_Sub_nodes_own_.create_node(document_id);
 
-    for (const char* word : s)
-        _add_word(word, document_id, node->get_value());
+    std::vector<std::uint32_t> handles;
+    handles.reserve(words.size());
+    root_.add_words(words, document_id, [&](Node* n, const char* w) {
+        words_.insert(w, n->sub_node());
+        handles.push_back(arena_.handle(*n->sub_node()));
+    });
+    *node->get_value() = arena_.store(handles);
 
     node->get_mutex().unlock();
 }
@@ -121,8 +157,14 @@ void Fusion_Dictionary::_remove(int document_id)
         return;
 
     auto value = node->get_value();
-    for (size_t i = 0; i < value->size(); ++i)
-        value->at(i)->erase(document_id);
+    for (const std::uint32_t h : *value)
+    {
+        Sub_node& sn = arena_[h];
+        if (sn.erase(document_id))
+            sn.owner->lower_best();
+    }
+    arena_.release(*value);
+    *value = handle_span{};
 
     node->get_mutex().unlock();
     book_Sub_nodes_own_.remove(document_id);
@@ -8,14 +8,17 @@
 #include <vector>
 
 #include "../IDictionary.hpp"
+#include "../trie_implementation/frozen_dictionary.hpp"
 #include "../trie_implementation/node.hpp"
+#include "../trie_implementation/sub_node_arena.hpp"
 #include "../hashmap_implementation/hashmap.hpp"
+#include "word_index.hpp"
 
 
 class Fusion_Dictionary : public IReversedDictionary
 {
 public:
-    using delete_map_own = hashmap<int, std::vector<std::shared_ptr<Sub_node>>>;
+    using delete_map_own = Node::delete_map_own;
 
     Fusion_Dictionary();
     Fusion_Dictionary(const dictionary_t& init);
@@ -28,19 +31,38 @@ public:
 
     virtual void init(const dictionary_t& d) final;
     virtual result_t search(const char* word) const final;
+    virtual void     search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const final;
+    virtual prepared_t prepare(const char* word) const final;
+    virtual result_t   search_prepared(const prepared_t& q) const final;
     virtual void insert(int document_id, gsl::span<const char*> text) final;
     virtual void remove(int document_id) final;
+
+    /// Search the words starting with \p prefix, the most indexed first,
+    /// with the documents containing them
+    std::vector<completion_t> search_prefix(const char* prefix,
+                                            int limit = MAX_RESULT_COUNT) const;
+
+    /// Search the words within \p max_edits insertions, deletions, substitutions
+    /// or transpositions of \p word, the closest first, with the documents containing them
+    std::vector<completion_t> search_fuzzy(const char* word, int max_edits,
+                                           int limit = MAX_RESULT_COUNT) const;
+
+    /// Immutable copy of the current index for lock-free read-only serving
+    Frozen_Dictionary freeze() const;
+
     void _add_word(const char* word, int book);
-    void _add_word(const char* word, int book,
-                   std::shared_ptr<std::vector<std::shared_ptr<Sub_node>>> vect);
 
     // TODO private
     Node root_;
 
+    Sub_node_arena arena_; // Sub_node handles and the handle arrays of book_Sub_nodes_own_
     delete_map_own book_Sub_nodes_own_;
 
 private:
     void _init(const dictionary_t& d);
     void _search_word(const char* word, result_t& r) const;
     void _remove(int document_id);
+
+    Word_Index    words_; // Word -> Sub_node, for exact searches
+    instance_id_t id_;    // Owner of the prepared_t resolved here
 };
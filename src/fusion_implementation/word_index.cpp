@@ -0,0 +1,212 @@
+#include "word_index.hpp"
+
+#include <cstring>
+
+Word_Index::table::table(std::size_t capacity)
+    : slots(std::make_unique<slot[]>(capacity))
+    , mask(capacity - 1)
+{}
+
+Word_Index::Word_Index()
+{
+    tables_.push_back(std::make_unique<table>(INITIAL_CAPACITY));
+    table_.store(tables_.back().get());
+}
+
+std::uint64_t Word_Index::hash(const char* word)
+{
+    // FNV-1a, then mixed so that the low bits depend on every letter
+    std::uint64_t h = 14695981039346656037ull;
+    for (; *word != '\0'; ++word)
+        h = (h ^ std::uint8_t(*word)) * 1099511628211ull;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h != 0 ? h : 1;
+}
+
+const Sub_node* Word_Index::find(const char* word) const
+{
+    const std::uint64_t h = hash(word);
+    const table&        t = *table_.load();
+
+    for (std::size_t i = h;; ++i)
+    {
+        const slot&         s  = t.slots[i & t.mask];
+        const std::uint64_t sh = s.hash.load();
+        if (sh == 0)
+            return nullptr;
+        if (sh == h)
+        {
+            const Sub_node* sub_node = s.sub_node.load();
+            if (sub_node != nullptr && std::strcmp(s.word.load(std::memory_order_relaxed), word) == 0)
+                return sub_node;
+        }
+    }
+}
+
+void Word_Index::find_batch(const char* const* words, std::size_t n, const Sub_node** out) const
+{
+    std::uint64_t h[BATCH];
+    const slot*   candidate[BATCH];
+    const table&  t = *table_.load();
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        h[i] = hash(words[i]);
+        __builtin_prefetch(&t.slots[h[i] & t.mask]);
+    }
+
+    // First slot with the same hash, its key is compared once loaded
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        candidate[i] = nullptr;
+        for (std::size_t j = h[i];; ++j)
+        {
+            const slot&         s  = t.slots[j & t.mask];
+            const std::uint64_t sh = s.hash.load();
+            if (sh == 0)
+                break;
+            if (sh == h[i] && s.sub_node.load() != nullptr)
+            {
+                candidate[i] = &s;
+                __builtin_prefetch(s.word.load(std::memory_order_relaxed));
+                break;
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (candidate[i] == nullptr)
+            out[i] = nullptr;
+        else if (std::strcmp(candidate[i]->word.load(std::memory_order_relaxed), words[i]) == 0)
+            out[i] = candidate[i]->sub_node.load(std::memory_order_relaxed);
+        else
+            out[i] = find(words[i]); // Another word with the same hash
+    }
+}
+
+void Word_Index::insert(const char* word, const Sub_node* sub_node)
+{
+    const std::uint64_t h   = hash(word);
+    const char*         key = nullptr; // Copy of word, made once a free slot is found
+    table*              t   = table_.load();
+
+    while (true)
+    {
+        if (!_insert(*t, h, word, key, sub_node))
+            _grow(*t);
+        else if (!t->sealed.load())
+            return;
+        else
+        {
+            // The copy of t may have missed the slot: wait for the copy to end
+            // and insert again in the new table
+            std::lock_guard l(m_);
+        }
+        t = table_.load();
+    }
+}
+
+bool Word_Index::_insert(table& t, std::uint64_t h, const char* word, const char*& key,
+                         const Sub_node* sub_node)
+{
+    // Keep the table at most half full so that probes stay short
+    const std::size_t capacity = t.mask + 1;
+    if (2 * (t.size.load(std::memory_order_relaxed) + 1) > capacity)
+        return false;
+
+    // Counted in probes, h + capacity may overflow
+    for (std::size_t n = 0; n < capacity; ++n)
+    {
+        slot&         s  = t.slots[(h + n) & t.mask];
+        std::uint64_t sh = s.hash.load();
+        if (sh == 0)
+        {
+            if (key == nullptr)
+                key = _store(word);
+            if (s.hash.compare_exchange_strong(sh, h))
+            {
+                t.size.fetch_add(1, std::memory_order_relaxed);
+                s.word.store(key, std::memory_order_relaxed);
+                s.sub_node.store(sub_node);
+                return true;
+            }
+            // Another thread took the slot, sh is now its hash
+        }
+        // A word has a single Sub_node, so the same Sub_node means the same word
+        if (sh == h && s.sub_node.load() == sub_node)
+            return true;
+    }
+    return false;
+}
+
+void Word_Index::_grow(table& t)
+{
+    std::lock_guard l(m_);
+    if (table_.load() != &t)
+        return;
+
+    // A slot filled after being read here is inserted again by its writer, which
+    // sees t sealed
+    t.sealed.store(true);
+    auto bigger = std::make_unique<table>(2 * (t.mask + 1));
+    for (std::size_t i = 0; i <= t.mask; ++i)
+    {
+        const slot&     s        = t.slots[i];
+        const Sub_node* sub_node = s.sub_node.load();
+        if (sub_node != nullptr)
+            _copy(*bigger, s.hash.load(std::memory_order_relaxed),
+                  s.word.load(std::memory_order_relaxed), sub_node);
+    }
+
+    table_.store(bigger.get());
+    tables_.push_back(std::move(bigger));
+}
+
+void Word_Index::_copy(table& t, std::uint64_t h, const char* key, const Sub_node* sub_node)
+{
+    for (std::size_t i = h;; ++i)
+    {
+        slot& s = t.slots[i & t.mask];
+        if (s.hash.load(std::memory_order_relaxed) == 0)
+        {
+            s.hash.store(h, std::memory_order_relaxed);
+            s.word.store(key, std::memory_order_relaxed);
+            s.sub_node.store(sub_node, std::memory_order_relaxed);
+            t.size.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (s.sub_node.load(std::memory_order_relaxed) == sub_node)
+            return;
+    }
+}
+
+const char* Word_Index::_store(const char* word)
+{
+    const std::size_t n = std::strlen(word) + 1;
+
+    std::lock_guard l(m_);
+    char* key;
+    if (n > CHUNK_SIZE / 4)
+    {
+        // Long words get a chunk of their own
+        chunks_.push_back(std::make_unique<char[]>(n));
+        key = chunks_.back().get();
+    }
+    else
+    {
+        if (used_ + n > CHUNK_SIZE)
+        {
+            chunks_.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+            chunk_ = chunks_.back().get();
+            used_  = 0;
+        }
+        key = chunk_ + used_;
+        used_ += n;
+    }
+
+    std::memcpy(key, word, n);
+    return key;
+}
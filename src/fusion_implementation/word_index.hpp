@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../trie_implementation/sub_node.hpp"
+
+/// Concurrent hash index from a word to its Sub_node in the trie
+///
+/// Open addressing with linear probing. Nodes are never deleted from the trie,
+/// so entries are never removed either: insertions only claim empty slots with
+/// a CAS and lookups take no lock. A full table is copied into one twice as big;
+/// old tables are kept until destruction for the readers still probing them.
+/// A word is found by find() once insert() of that word has returned.
+class Word_Index
+{
+public:
+    Word_Index();
+
+    /// Sub_node of word, nullptr if it was never inserted
+    const Sub_node* find(const char* word) const;
+
+    static constexpr std::size_t BATCH = 16; // Lookups interleaved by find_batch
+
+    /// find() of the n <= BATCH words, in stages over all of them so that their
+    /// cache misses overlap: the slots are prefetched, then the keys, then compared
+    void find_batch(const char* const* words, std::size_t n, const Sub_node** out) const;
+
+    /// Map word to sub_node, nothing is done if it is already there
+    void insert(const char* word, const Sub_node* sub_node);
+
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 1 << 12;
+    static constexpr std::size_t CHUNK_SIZE       = 1 << 16; // Bytes per chunk of keys
+
+    struct slot
+    {
+        std::atomic<std::uint64_t>   hash{0};           // 0 if the slot is empty
+        std::atomic<const char*>     word{nullptr};     // Written before sub_node
+        std::atomic<const Sub_node*> sub_node{nullptr}; // nullptr until the slot is filled
+    };
+
+    struct table
+    {
+        explicit table(std::size_t capacity);
+
+        std::unique_ptr<slot[]>  slots;
+        std::size_t              mask; // Capacity - 1, capacity is a power of 2
+        std::atomic<std::size_t> size{0};
+        std::atomic<bool>        sealed{false}; // Set once the table is being copied
+    };
+
+    static std::uint64_t hash(const char* word);
+
+    // Insert in t, return false if t is too full
+    bool _insert(table& t, std::uint64_t h, const char* word, const char*& key,
+                 const Sub_node* sub_node);
+
+    // Publish a table twice as big as t if t is still the current one
+    void _grow(table& t);
+
+    // Insert in t, which no other thread can see yet
+    static void _copy(table& t, std::uint64_t h, const char* key, const Sub_node* sub_node);
+
+    // Copy of word that lives as long as the index
+    const char* _store(const char* word);
+
+    std::atomic<table*> table_;
+
+    std::mutex                           m_; // To lock when growing or storing a key
+    std::vector<std::unique_ptr<table>>  tables_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char*                                chunk_ = nullptr;    // Chunk short keys are taken from
+    std::size_t                          used_  = CHUNK_SIZE; // Bytes used in chunk_
+};
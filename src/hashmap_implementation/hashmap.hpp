@@ -40,11 +40,30 @@ public:
         next_ = next;
     }
 
+    // Call f with the value under a shared lock, unless the node was removed from its map
+    // Return false if removed
+    template <typename F>
+    bool read_value(F&& f) const
+    {
+        std::shared_lock lock(mutex_);
+        if (removed_)
+            return false;
+        f(*value_);
+        return true;
+    }
+
+    // To call with the node locked exclusively
+    void set_removed()
+    {
+        removed_ = true;
+    }
+
 private:
     K key_;
     std::shared_ptr<V> value_;
     std::shared_ptr<hashmap_node> next_;
     mutable std::shared_mutex mutex_;
+    bool removed_ = false; // Unlinked from its map, still alive for the holders of a pointer
 };
 
 enum class lock_type
@@ -215,7 +234,7 @@ public:
         return node;
     }
 
-    node_ptr_t find_node_unlocked(const K& key)
+    node_ptr_t find_node_unlocked(const K& key) const
     {
         unsigned long index = hash(key);
         node_ptr_t node = data_.at(index);
@@ -259,6 +278,7 @@ public:
         // At this stage prev_node and node are locked because
         // we called forward_remove
         prev_node->set_next(node->get_next());
+        node->set_removed();
     }
 
     template <typename T>
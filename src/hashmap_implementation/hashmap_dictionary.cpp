@@ -37,6 +37,28 @@ result_t hashmap_dictionary::search(const char* word) const
     return r;
 }
 
+prepared_t hashmap_dictionary::prepare(const char* word) const
+{
+    // The node is kept alive by the handle, and flagged if removed from the map
+    auto node = m_rev_dico.find_node_unlocked(word);
+    if (node == nullptr)
+        return {word, nullptr, 0};
+    return {word, std::move(node), id_.value};
+}
+
+result_t hashmap_dictionary::search_prepared(const prepared_t& q) const
+{
+    if (q.owner != id_.value)
+        return search(q.word.c_str());
+
+    result_t r;
+    const bool found = static_cast<const rev_node_t*>(q.location.get())->read_value([&r](const std::vector<int>& ids) {
+        r.m_count = std::min(int(ids.size()), MAX_RESULT_COUNT);
+        std::copy_n(ids.begin(), r.m_count, r.m_matched);
+    });
+    return found ? r : search(q.word.c_str());
+}
+
 void hashmap_dictionary::insert(int document_id, gsl::span<const char*> text)
 {
     if (m_dico.find_node_unlocked(document_id) != nullptr)
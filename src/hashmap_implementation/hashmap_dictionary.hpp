@@ -17,6 +17,8 @@ public:
 
   virtual void     init(const dictionary_t& d) final;
   virtual result_t search(const char* word) const final;
+  virtual prepared_t prepare(const char* word) const final;
+  virtual result_t   search_prepared(const prepared_t& q) const final;
   virtual void     insert(int document_id, gsl::span<const char*> text) final;
   virtual void     remove(int document_id) final;
 
@@ -24,6 +26,9 @@ public:
 private:
   void _init(const dictionary_t& d);
 
+  using rev_node_t = hashmap_node<std::string, std::vector<int>>;
+
   hashmap<int, std::vector<std::string>> m_dico;
   hashmap<std::string, std::vector<int>> m_rev_dico;
+  instance_id_t id_; // Owner of the prepared_t resolved here
 };
\ No newline at end of file
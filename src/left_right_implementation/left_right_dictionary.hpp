@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../IDictionary.hpp"
+
+/// Two copies of a dictionary, read and written with the left-right technique
+///
+/// Readers always search a copy no writer touches: they count themselves in
+/// the read indicator of the current version, read the copy published for
+/// reads, and leave. That is two increments of a counter of their own, so reads
+/// never wait and never share a cache line. Writers take turns: a write goes to
+/// the other copy, which is then published for reads, and goes to the first
+/// copy once the readers still on it are gone.
+///
+/// A copy is only ever used by one writer or by readers, so DICTIONARY may lock
+/// nothing: Dictionary<..., No_Lock_Policy> removes the shared locks of the
+/// reads too. The price is twice the memory, and writes done twice.
+template <typename DICTIONARY>
+class Left_Right_Dictionary : public IReversedDictionary
+{
+public:
+    static constexpr int N_STRIPES = 64; // Counters per read indicator, threads beyond share them
+
+    Left_Right_Dictionary()
+        : copies_{std::make_unique<DICTIONARY>(), std::make_unique<DICTIONARY>()}
+    {}
+
+    Left_Right_Dictionary(const dictionary_t& d)
+        : Left_Right_Dictionary()
+    {
+        init(d);
+    }
+
+    virtual void init(const dictionary_t& d) final
+    {
+        write([&d](DICTIONARY& dic) { dic.init(d); });
+    }
+
+    virtual result_t search(const char* word) const final
+    {
+        read_indicator_t& indicator = indicators_[version_.load()];
+        std::atomic<long>& mine      = indicator.stripes[stripe()].readers;
+        mine.fetch_add(1);
+        const result_t r = copies_[read_copy_.load()]->search(word);
+        mine.fetch_sub(1);
+        return r;
+    }
+
+    virtual void insert(int document_id, gsl::span<const char*> text) final
+    {
+        write([document_id, text](DICTIONARY& dic) { dic.insert(document_id, text); });
+    }
+
+    virtual void remove(int document_id) final
+    {
+        write([document_id](DICTIONARY& dic) { dic.remove(document_id); });
+    }
+
+private:
+    struct read_indicator_t
+    {
+        struct alignas(64) stripe_t
+        {
+            std::atomic<long> readers{0};
+        };
+
+        bool empty() const
+        {
+            for (const auto& s : stripes)
+                if (s.readers.load() != 0)
+                    return false;
+            return true;
+        }
+
+        stripe_t stripes[N_STRIPES];
+    };
+
+    static unsigned stripe()
+    {
+        static std::atomic<unsigned> next{0};
+        thread_local const unsigned index = next++ % N_STRIPES;
+        return index;
+    }
+
+    // Apply f to the copy not read, publish it, wait for the readers of the other one, apply f to it
+    template <typename F>
+    void write(F&& f)
+    {
+        std::lock_guard l(writer_m_);
+
+        const int read = read_copy_.load();
+        f(*copies_[1 - read]);
+        read_copy_.store(1 - read);
+
+        // New readers count themselves in the other indicator, once it is empty. Then
+        // the readers of the first one, which may still read copy read, are waited for
+        const int version = version_.load();
+        wait_empty(indicators_[1 - version]);
+        version_.store(1 - version);
+        wait_empty(indicators_[version]);
+
+        f(*copies_[read]);
+    }
+
+    static void wait_empty(const read_indicator_t& indicator)
+    {
+        while (!indicator.empty())
+            std::this_thread::yield();
+    }
+
+    std::unique_ptr<DICTIONARY> copies_[2];
+    std::atomic<int>            read_copy_{0}; // Copy the readers search
+    std::atomic<int>            version_{0};   // Read indicator the readers count themselves in
+    mutable read_indicator_t    indicators_[2];
+    std::mutex                  writer_m_;
+};
@@ -0,0 +1,232 @@
+#include "lsm_dictionary.hpp"
+
+#include <algorithm>
+
+Lsm_Dictionary::Lsm_Dictionary(std::size_t merge_threshold, bool background)
+    : threshold_(std::max<std::size_t>(1, merge_threshold))
+{
+    std::unique_lock s(swap_m_);
+    publish(std::make_shared<const Frozen_Dictionary>(), nullptr, std::make_shared<delta_t>(next_gen_++));
+    if (background)
+        merger_ = std::thread([this] { run(); });
+}
+
+Lsm_Dictionary::Lsm_Dictionary(const dictionary_t& d)
+    : Lsm_Dictionary()
+{
+    init(d);
+}
+
+Lsm_Dictionary::~Lsm_Dictionary()
+{
+    {
+        std::lock_guard l(cv_m_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (merger_.joinable())
+        merger_.join();
+}
+
+void Lsm_Dictionary::init(const dictionary_t& d)
+{
+    std::lock_guard m(merge_m_);
+    {
+        std::unique_lock s(swap_m_);
+
+        fold(*segments_.get()->active);
+
+        dictionary_t added;
+        for (const auto& [id, text] : d)
+            if (live_.insert({id, 0}))
+                added.emplace(id, text);
+        base_.init(added);
+
+        publish(std::make_shared<const Frozen_Dictionary>(base_.freeze()), nullptr,
+                std::make_shared<delta_t>(next_gen_++));
+        pending_ = 0;
+        merges_++;
+        writes_++;
+    }
+    segments_.collect();
+}
+
+result_t Lsm_Dictionary::search(const char* word) const
+{
+    // The segments are read one after the other: a write completed meanwhile may
+    // be half seen, say a document removed from main and its replacement not in the delta yet
+    for (int i = 0; i < MAX_RETRIES; ++i)
+    {
+        const std::uint64_t w = writes_.load();
+        const result_t      r = _search(*segments_.read(), word);
+        if (writes_.load() == w)
+            return r;
+    }
+
+    // Under a steady stream of writes, the writes are held for the time of one search
+    std::unique_lock s(swap_m_);
+    return _search(*segments_.get(), word);
+}
+
+result_t Lsm_Dictionary::_search(const segments_t& seg, const char* word) const
+{
+    // Documents of the main segment removed since it was built are skipped
+    const bool any_removed = !seg.active->tombstones.empty() || (seg.merging && !seg.merging->tombstones.empty());
+    const auto removed     = [&seg](int id) {
+        return seg.active->tombstones.count(id) != 0 || (seg.merging && seg.merging->tombstones.count(id) != 0);
+    };
+
+    result_t r;
+    for (int id : seg.main->books(word))
+    {
+        if (r.m_count == MAX_RESULT_COUNT)
+            return r;
+        if (!any_removed || !removed(id))
+            r.m_matched[r.m_count++] = id;
+    }
+
+    // A document folded by the running merge is still in the merging delta only
+    const auto append = [&r](const result_t& delta) {
+        for (int i = 0; i < delta.m_count && r.m_count < MAX_RESULT_COUNT; ++i)
+            r.m_matched[r.m_count++] = delta.m_matched[i];
+    };
+    if (seg.merging && r.m_count < MAX_RESULT_COUNT)
+        append(seg.merging->index.search(word));
+    if (r.m_count < MAX_RESULT_COUNT)
+        append(seg.active->index.search(word));
+    return r;
+}
+
+void Lsm_Dictionary::insert(int document_id, gsl::span<const char*> text)
+{
+    std::shared_lock s(swap_m_);
+    delta_t&         delta = *segments_.get()->active;
+
+    // The accessor orders the writes of a document in the log
+    live_t::accessor a;
+    if (!live_.insert(a, document_id))
+        return;
+    a->second = delta.gen;
+
+    delta.index.insert(document_id, text);
+    {
+        std::lock_guard l(delta.log_m);
+        delta.log.push_back({document_id, true, std::vector<std::string>(text.begin(), text.end())});
+    }
+    a.release();
+    writes_++;
+
+    if (++pending_ == threshold_)
+    {
+        std::lock_guard l(cv_m_);
+        cv_.notify_one();
+    }
+}
+
+void Lsm_Dictionary::remove(int document_id)
+{
+    std::shared_lock  s(swap_m_);
+    const segments_t& seg   = *segments_.get();
+    delta_t&          delta = *seg.active;
+
+    live_t::accessor a;
+    if (!live_.find(a, document_id))
+        return;
+
+    if (a->second == delta.gen)
+        delta.index.remove(document_id);
+    else
+    {
+        // Hidden from the main segment by the tombstone, from the merging delta at once
+        delta.tombstones.insert(document_id);
+        if (seg.merging && a->second == seg.merging->gen)
+            seg.merging->index.remove(document_id);
+    }
+    {
+        std::lock_guard l(delta.log_m);
+        delta.log.push_back({document_id, false, {}});
+    }
+    live_.erase(a);
+    writes_++;
+
+    if (++pending_ == threshold_)
+    {
+        std::lock_guard l(cv_m_);
+        cv_.notify_one();
+    }
+}
+
+void Lsm_Dictionary::merge()
+{
+    std::lock_guard m(merge_m_);
+
+    // New writes go to a new delta, the log of the old one is not written anymore
+    std::shared_ptr<delta_t> folded;
+    {
+        std::unique_lock s(swap_m_);
+        folded = segments_.get()->active;
+        if (folded->log.empty())
+            return;
+        publish(segments_.get()->main, folded, std::make_shared<delta_t>(next_gen_++));
+        pending_ = 0;
+    }
+
+    fold(*folded);
+    auto main = std::make_shared<const Frozen_Dictionary>(base_.freeze());
+
+    // The tombstones of the active delta may hide documents of the folded one, now in main
+    {
+        std::unique_lock s(swap_m_);
+        publish(std::move(main), nullptr, segments_.get()->active);
+        merges_++;
+    }
+    segments_.collect();
+}
+
+std::size_t Lsm_Dictionary::delta_size() const
+{
+    return pending_.load();
+}
+
+std::uint64_t Lsm_Dictionary::merges() const
+{
+    return merges_.load();
+}
+
+void Lsm_Dictionary::publish(std::shared_ptr<const Frozen_Dictionary> main, std::shared_ptr<delta_t> merging,
+                             std::shared_ptr<delta_t> active)
+{
+    segments_.store(
+        std::make_shared<const segments_t>(segments_t{std::move(main), std::move(merging), std::move(active)}));
+}
+
+void Lsm_Dictionary::fold(const delta_t& delta)
+{
+    std::vector<const char*> text;
+    for (const op_t& op : delta.log)
+    {
+        if (!op.insert)
+        {
+            base_.remove(op.id);
+            continue;
+        }
+        text.clear();
+        for (const std::string& word : op.words)
+            text.push_back(word.c_str());
+        base_.insert(op.id, text);
+    }
+}
+
+void Lsm_Dictionary::run()
+{
+    std::unique_lock l(cv_m_);
+    while (true)
+    {
+        cv_.wait(l, [this] { return stop_ || pending_.load() >= threshold_; });
+        if (stop_)
+            return;
+        l.unlock();
+        merge();
+        l.lock();
+    }
+}
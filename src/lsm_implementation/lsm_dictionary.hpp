@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tbb/concurrent_hash_map.h>
+#include <tbb/concurrent_unordered_set.h>
+
+#include "../IDictionary.hpp"
+#include "../epoch_ptr.hpp"
+#include "../policy_implementation/policy_dictionary.hpp"
+#include "../trie_implementation/frozen_dictionary.hpp"
+#include "../trie_implementation/tree_dictionary.hpp"
+
+/// Reversed dictionary split in an immutable main segment and a small delta
+///
+/// Writes go to the delta, a hash index with spin locks, and are logged. A merge
+/// replays the log on a private trie, freezes it into a new main segment and
+/// swaps it in: the main segment is a Frozen_Dictionary, read without a lock.
+/// A search reads the main segment, skips the documents removed since it was
+/// built, then appends the matches of the delta. Main documents are older than
+/// delta ones, so results keep the insertion order of the other dictionaries.
+///
+/// Writes made while a merge runs go to a new delta. The delta being folded is
+/// still searched until the new main segment is published. A search during
+/// which a write completed is done again, so it never mixes two states. After
+/// MAX_RETRIES tries, it is done once more with the writes held.
+/// Replaced segments are freed once the searches that read them are done.
+class Lsm_Dictionary : public IReversedDictionary
+{
+public:
+    static constexpr std::size_t MERGE_THRESHOLD = 4096; // Writes in the delta that start a merge
+    static constexpr int         MAX_RETRIES     = 4;    // Searches before holding the writes
+
+    explicit Lsm_Dictionary(std::size_t merge_threshold = MERGE_THRESHOLD, bool background = true);
+    Lsm_Dictionary(const dictionary_t& d);
+    ~Lsm_Dictionary();
+
+    /// Insert the documents of d in the main segment, folding the delta first
+    virtual void init(const dictionary_t& d) final;
+
+    virtual result_t search(const char* word) const final;
+    virtual void     insert(int document_id, gsl::span<const char*> text) final;
+    virtual void     remove(int document_id) final;
+
+    /// Fold the delta into a new main segment, after the merge already running if any
+    void merge();
+
+    /// Writes not folded into the main segment yet
+    std::size_t delta_size() const;
+
+    /// Main segments built since construction
+    std::uint64_t merges() const;
+
+private:
+    // Write logged for the next merge
+    struct op_t
+    {
+        int                      id;
+        bool                     insert;
+        std::vector<std::string> words; // insert
+    };
+
+    struct delta_t
+    {
+        explicit delta_t(std::uint64_t gen)
+            : gen(gen)
+        {}
+
+        const std::uint64_t                                  gen;
+        Dictionary<Hash_Index, Vector_Postings, Spin_Policy> index;      // Documents inserted since the delta started
+        tbb::concurrent_unordered_set<int>                   tombstones; // Documents of older segments removed since
+        std::mutex                                           log_m;
+        std::vector<op_t>                                    log;
+    };
+
+    struct segments_t
+    {
+        std::shared_ptr<const Frozen_Dictionary> main;
+        std::shared_ptr<delta_t>                 merging; // Delta being folded, null if no merge runs
+        std::shared_ptr<delta_t>                 active;  // Delta taking the writes
+    };
+
+    result_t _search(const segments_t& seg, const char* word) const;
+
+    // Publish new segments, swap_m_ locked. The old ones are freed by segments_.collect()
+    void publish(std::shared_ptr<const Frozen_Dictionary> main, std::shared_ptr<delta_t> merging,
+                 std::shared_ptr<delta_t> active);
+
+    // Replay the log of delta on base_
+    void fold(const delta_t& delta);
+
+    void run();
+
+    // Delta a live document was inserted in, 0 for the main segment
+    using live_t = tbb::concurrent_hash_map<int, std::uint64_t>;
+
+    const std::size_t threshold_;
+
+    live_t          live_;
+    Tree_Dictionary base_; // Every folded write, only touched by merges
+
+    Epoch_Ptr<segments_t>      segments_;
+    mutable std::shared_mutex  swap_m_;     // Shared by writers, exclusive to switch deltas and for retried searches
+    std::mutex                 merge_m_;    // One merge at a time
+    std::uint64_t              next_gen_ = 1;
+    std::atomic<std::size_t>   pending_{0}; // Writes in the active delta
+    std::atomic<std::uint64_t> merges_{0};
+    std::atomic<std::uint64_t> writes_{0};  // Writes completed, searches retry when it moves
+
+    std::mutex              cv_m_; // To lock when sleeping or waking the merger up
+    std::condition_variable cv_;
+    bool                    stop_ = false;
+    std::thread             merger_;
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include <tbb/concurrent_hash_map.h>
+
+#include "../IDictionary.hpp"
+#include "../policy_implementation/policies.hpp"
+#include "../policy_implementation/word_indexes.hpp"
+
+/// Reversed dictionary with multi-version concurrency control
+///
+/// Each write commits under a version of a global clock. The entries of a
+/// posting list carry the versions their document was inserted and removed
+/// at, so a reader at version s sees the documents inserted at or before s and
+/// not removed by then. Writes become visible in version order: a reader never
+/// sees half of a document, nor a later write without the earlier ones.
+///
+/// snapshot() pins the last visible version. Its searches all see that state,
+/// with no lock but the short shared lock of each posting list. The entries of
+/// removed documents are collected once no snapshot is older than their removal.
+template <template <class, class> class WordIndex = Hash_Index>
+class Mvcc_Dictionary : public IReversedDictionary
+{
+    static constexpr std::uint64_t NEVER  = std::numeric_limits<std::uint64_t>::max();
+    static constexpr std::uint64_t TAKING = NEVER; // Slot of a snapshot not published yet
+
+public:
+    static constexpr int MAX_SNAPSHOTS = 256; // Snapshots alive at once, more wait for a free slot
+    static constexpr int GC_PERIOD     = 64;  // Removes between two collections
+
+    /// Read view of the dictionary at one version
+    class snapshot_t
+    {
+    public:
+        snapshot_t(snapshot_t&& other)
+            : dic_(other.dic_)
+            , slot_(other.slot_)
+            , version_(other.version_)
+        {
+            other.slot_ = nullptr;
+        }
+
+        snapshot_t& operator=(snapshot_t&&) = delete;
+
+        ~snapshot_t()
+        {
+            if (slot_ != nullptr)
+                slot_->store(0, std::memory_order_release);
+        }
+
+        result_t search(const char* word) const
+        {
+            return dic_->_search(word, version_);
+        }
+
+        std::uint64_t version() const
+        {
+            return version_;
+        }
+
+    private:
+        friend class Mvcc_Dictionary;
+
+        snapshot_t(const Mvcc_Dictionary* dic, std::atomic<std::uint64_t>* slot, std::uint64_t version)
+            : dic_(dic)
+            , slot_(slot)
+            , version_(version)
+        {}
+
+        const Mvcc_Dictionary*      dic_;
+        std::atomic<std::uint64_t>* slot_; // Holds version + 1 while the snapshot lives, null once moved
+        std::uint64_t               version_;
+    };
+
+    Mvcc_Dictionary() = default;
+
+    Mvcc_Dictionary(const dictionary_t& d)
+    {
+        init(d);
+    }
+
+    /// Insert the documents of d in a single commit
+    virtual void init(const dictionary_t& d) final
+    {
+        // Documents already there are released, the others held until their words are added
+        std::vector<typename docs_t::accessor> docs(d.size());
+        auto doc = docs.begin();
+        for (const auto& [id, text] : d)
+        {
+            if (!docs_.insert(*doc, id))
+                doc->release();
+            ++doc;
+        }
+
+        // Versions are taken once the documents are held, see insert()
+        const std::uint64_t v = next_.fetch_add(1);
+        doc = docs.begin();
+        for (const auto& [id, text] : d)
+        {
+            if (!doc->empty())
+                _insert(*doc, id, text, v);
+            ++doc;
+        }
+        _publish(v);
+    }
+
+    /// Search at the last visible version
+    virtual result_t search(const char* word) const final
+    {
+        return snapshot().search(word);
+    }
+
+    virtual void insert(int document_id, gsl::span<const char*> text) final
+    {
+        // The version is taken with the document held: a writer waiting for the
+        // publication of an earlier version never holds a document another one needs
+        typename docs_t::accessor a;
+        if (!docs_.insert(a, document_id))
+            return;
+
+        const std::uint64_t v = next_.fetch_add(1);
+        _insert(a, document_id, text, v);
+        a.release();
+        _publish(v);
+    }
+
+    virtual void remove(int document_id) final
+    {
+        typename docs_t::accessor a;
+        if (!docs_.find(a, document_id))
+            return;
+
+        const std::uint64_t v = next_.fetch_add(1);
+        for (posting_t* p : a->second)
+            p->end(document_id, v);
+        {
+            std::lock_guard l(garbage_m_);
+            for (posting_t* p : a->second)
+                garbage_.push_back({p, v});
+        }
+        docs_.erase(a);
+        _publish(v);
+
+        if (removes_.fetch_add(1) % GC_PERIOD == GC_PERIOD - 1)
+            collect();
+    }
+
+    /// Pin the last visible version, waiting if MAX_SNAPSHOTS are alive
+    snapshot_t snapshot() const
+    {
+        thread_local unsigned hint = 0; // Slot taken last by the thread
+        for (unsigned n = 0;; ++n)
+        {
+            auto&         slot = snapshots_[(hint + n) % MAX_SNAPSHOTS];
+            std::uint64_t free = 0;
+            if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(free, TAKING))
+            {
+                hint = (hint + n) % MAX_SNAPSHOTS;
+
+                // Checked again once published: collect() reads the version before the
+                // slots, so it sees either this slot or a version not newer than v
+                std::uint64_t v = visible_.load();
+                while (true)
+                {
+                    slot.store(v + 1);
+                    const std::uint64_t again = visible_.load();
+                    if (again == v)
+                        return snapshot_t(this, &slot, v);
+                    v = again;
+                }
+            }
+            if (n % MAX_SNAPSHOTS == MAX_SNAPSHOTS - 1)
+                std::this_thread::yield();
+        }
+    }
+
+    /// Drop the entries removed before the oldest snapshot, done every GC_PERIOD removes
+    void collect()
+    {
+        std::unique_lock gc(gc_m_, std::try_to_lock);
+        if (!gc)
+            return;
+
+        const std::uint64_t horizon = oldest();
+        std::vector<garbage_t> ready;
+        {
+            std::lock_guard l(garbage_m_);
+            // Removed versions are published in order but queued in any order
+            auto it = std::partition(garbage_.begin(), garbage_.end(),
+                                     [horizon](const garbage_t& g) { return g.removed > horizon; });
+            ready.assign(it, garbage_.end());
+            garbage_.erase(it, garbage_.end());
+        }
+
+        for (const garbage_t& g : ready)
+            g.posting->collect(horizon);
+    }
+
+    /// Entries of removed documents not collected yet
+    std::size_t garbage() const
+    {
+        std::lock_guard l(garbage_m_);
+        return garbage_.size();
+    }
+
+    /// Last visible version
+    std::uint64_t version() const
+    {
+        return visible_.load();
+    }
+
+private:
+    struct entry_t
+    {
+        int           id;
+        std::uint64_t inserted;
+        std::uint64_t removed;
+    };
+
+    // Entries of a word, in insertion order
+    struct posting_t
+    {
+        void add(int id, std::uint64_t v)
+        {
+            std::unique_lock l(m);
+            entries.push_back({id, v, NEVER});
+        }
+
+        void end(int id, std::uint64_t v)
+        {
+            std::unique_lock l(m);
+            for (entry_t& e : entries)
+                if (e.id == id && e.removed == NEVER)
+                    e.removed = v;
+        }
+
+        void read(result_t& r, std::uint64_t s) const
+        {
+            std::shared_lock l(m);
+            r.m_count = 0;
+            for (auto e = entries.begin(); e != entries.end() && r.m_count < MAX_RESULT_COUNT; ++e)
+                if (e->inserted <= s && s < e->removed)
+                    r.m_matched[r.m_count++] = e->id;
+        }
+
+        // Drop the entries no snapshot from horizon on can see
+        void collect(std::uint64_t horizon)
+        {
+            std::unique_lock l(m);
+            entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                         [horizon](const entry_t& e) { return e.removed <= horizon; }),
+                          entries.end());
+        }
+
+        mutable std::shared_mutex m;
+        std::vector<entry_t>      entries;
+    };
+
+    struct garbage_t
+    {
+        posting_t*    posting;
+        std::uint64_t removed;
+    };
+
+    using docs_t = tbb::concurrent_hash_map<int, std::vector<posting_t*>>;
+
+    result_t _search(const char* word, std::uint64_t s) const
+    {
+        result_t r;
+        if (const posting_t* p = words_.find(word))
+            p->read(r, s);
+        return r;
+    }
+
+    void _insert(typename docs_t::accessor& a, int id, gsl::span<const char*> text, std::uint64_t v)
+    {
+        std::vector<const char*> words(text.begin(), text.end());
+        std::sort(words.begin(), words.end(), [](const char* x, const char* y) { return std::strcmp(x, y) < 0; });
+        words.erase(std::unique(words.begin(), words.end(),
+                                [](const char* x, const char* y) { return std::strcmp(x, y) == 0; }),
+                    words.end());
+
+        for (const char* word : words)
+        {
+            posting_t& p = words_.find_or_add(word);
+            p.add(id, v);
+            a->second.push_back(&p);
+        }
+    }
+
+    // Make v visible once the versions before it are
+    void _publish(std::uint64_t v)
+    {
+        while (visible_.load() != v - 1)
+            std::this_thread::yield();
+        visible_.store(v);
+    }
+
+    // Oldest version a snapshot may read
+    std::uint64_t oldest() const
+    {
+        // A snapshot being taken reads a version not older than this one
+        std::uint64_t horizon = visible_.load();
+        for (const auto& slot : snapshots_)
+        {
+            const std::uint64_t s = slot.load();
+            if (s != 0 && s != TAKING)
+                horizon = std::min(horizon, s - 1);
+        }
+        return horizon;
+    }
+
+    WordIndex<posting_t, Shared_Mutex_Policy> words_;
+    docs_t                                    docs_;
+
+    std::atomic<std::uint64_t> next_{1};    // Version of the next write
+    std::atomic<std::uint64_t> visible_{0}; // Writes up to this version are visible
+
+    mutable std::atomic<std::uint64_t> snapshots_[MAX_SNAPSHOTS] = {}; // 0 if free
+
+    mutable std::mutex     garbage_m_;
+    std::vector<garbage_t> garbage_; // Removed entries, to collect
+    std::mutex             gc_m_;
+    std::atomic<unsigned>  removes_{0};
+};
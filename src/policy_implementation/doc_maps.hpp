@@ -0,0 +1,78 @@
+#pragma once
+
+#include <tbb/concurrent_hash_map.h>
+#include <unordered_map>
+
+/// Document maps: map a document id to the V listing its posting lists, to remove it
+/// insert() and erase() may run concurrently. The document is locked while f runs,
+/// so that a document is indexed once and removed once. LockPolicy is the lock
+/// policy of the dictionary, for the maps that lock.
+
+/// tbb::concurrent_hash_map, an accessor locks the document only, as in Tree_Dictionary
+template <class V, class LockPolicy>
+class Hash_Doc_Map
+{
+public:
+    /// Add id and call f with its value, return false if id is already there
+    template <class F>
+    bool insert(int id, F&& f)
+    {
+        typename map_t::accessor a;
+        if (!map_.insert(a, id))
+            return false;
+        f(a->second);
+        return true;
+    }
+
+    /// Call f with the value of id then remove it, return false if id is not there
+    template <class F>
+    bool erase(int id, F&& f)
+    {
+        typename map_t::accessor a;
+        if (!map_.find(a, id))
+            return false;
+        f(a->second);
+        map_.erase(a);
+        return true;
+    }
+
+private:
+    using map_t = tbb::concurrent_hash_map<int, V>;
+
+    map_t map_;
+};
+
+/// std::unordered_map under a single mutex of the lock policy: the writes are serialized
+template <class V, class LockPolicy>
+class Locked_Doc_Map
+{
+public:
+    /// Add id and call f with its value, return false if id is already there
+    template <class F>
+    bool insert(int id, F&& f)
+    {
+        typename LockPolicy::write_lock_t l(m_);
+        const auto [it, added] = map_.try_emplace(id);
+        if (!added)
+            return false;
+        f(it->second);
+        return true;
+    }
+
+    /// Call f with the value of id then remove it, return false if id is not there
+    template <class F>
+    bool erase(int id, F&& f)
+    {
+        typename LockPolicy::write_lock_t l(m_);
+        const auto it = map_.find(id);
+        if (it == map_.end())
+            return false;
+        f(it->second);
+        map_.erase(it);
+        return true;
+    }
+
+private:
+    typename LockPolicy::mutex_t m_;
+    std::unordered_map<int, V>   map_;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <tbb/spin_rw_mutex.h>
+#include <vector>
+
+#include "../IDictionary.hpp"
+
+/// Lock policies: the mutex of a posting list or of a word index, and its shared
+/// and exclusive scoped locks
+
+/// std::shared_mutex, readers sleep while a writer holds it
+struct Shared_Mutex_Policy
+{
+    using mutex_t      = std::shared_mutex;
+    using read_lock_t  = std::shared_lock<mutex_t>;
+    using write_lock_t = std::unique_lock<mutex_t>;
+};
+
+/// tbb::spin_rw_mutex, for short critical sections: a word has 8 bytes of lock
+/// instead of 56 and nobody sleeps
+struct Spin_Policy
+{
+    using mutex_t = tbb::spin_rw_mutex;
+
+    struct read_lock_t
+    {
+        explicit read_lock_t(mutex_t& m)
+            : l(m, false)
+        {}
+
+        mutex_t::scoped_lock l;
+    };
+
+    struct write_lock_t
+    {
+        explicit write_lock_t(mutex_t& m)
+            : l(m, true)
+        {}
+
+        mutex_t::scoped_lock l;
+    };
+};
+
+/// Nothing is locked: only for a dictionary used by one thread at a time
+struct No_Lock_Policy
+{
+    struct mutex_t
+    {};
+
+    struct read_lock_t
+    {
+        explicit read_lock_t(mutex_t&) {}
+    };
+
+    using write_lock_t = read_lock_t;
+};
+
+/// Posting lists: the documents of a word in insertion order, not locked (the
+/// dictionary locks them with its lock policy)
+
+/// All the documents in a vector
+class Vector_Postings
+{
+public:
+    void insert(int id)
+    {
+        ids_.push_back(id);
+    }
+
+    void erase(int id)
+    {
+        ids_.erase(std::remove(ids_.begin(), ids_.end(), id), ids_.end());
+    }
+
+    void read(result_t& r) const
+    {
+        r.m_count = std::min(int(ids_.size()), MAX_RESULT_COUNT);
+        std::copy_n(ids_.begin(), r.m_count, r.m_matched);
+    }
+
+private:
+    std::vector<int> ids_;
+};
+
+/// The first MAX_RESULT_COUNT documents inline, the others in a vector: a search
+/// reads the posting list without following a pointer
+class Head_Postings
+{
+public:
+    void insert(int id)
+    {
+        if (n_head_ < MAX_RESULT_COUNT)
+            head_[n_head_++] = id;
+        else
+            tail_.push_back(id);
+    }
+
+    void erase(int id)
+    {
+        int* const end = head_.data() + n_head_;
+        int* const it  = std::remove(head_.data(), end, id);
+        if (it == end)
+        {
+            tail_.erase(std::remove(tail_.begin(), tail_.end(), id), tail_.end());
+            return;
+        }
+
+        // The head is refilled from the front of the tail, to keep the order
+        n_head_ = int(it - head_.data());
+        const int moved = std::min(MAX_RESULT_COUNT - n_head_, int(tail_.size()));
+        std::copy_n(tail_.begin(), moved, it);
+        tail_.erase(tail_.begin(), tail_.begin() + moved);
+        n_head_ += moved;
+    }
+
+    void read(result_t& r) const
+    {
+        r.m_count = n_head_;
+        std::copy_n(head_.begin(), n_head_, r.m_matched);
+    }
+
+private:
+    int                                n_head_ = 0;
+    std::array<int, MAX_RESULT_COUNT> head_;
+    std::vector<int>                   tail_; // Documents after the head
+};
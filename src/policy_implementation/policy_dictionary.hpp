@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "../IDictionary.hpp"
+#include "doc_maps.hpp"
+#include "policies.hpp"
+#include "word_indexes.hpp"
+
+/// Reversed dictionary assembled at compile time from a word index, a posting
+/// list, a lock policy and a document map (see word_indexes.hpp, policies.hpp
+/// and doc_maps.hpp)
+///
+/// Nothing is virtual: search() is inlined in the callers that know the type.
+/// Virtual_Dictionary adapts it to IReversedDictionary, and Async_Dictionary
+/// takes it as is.
+template <template <class, class> class WordIndex, class PostingList, class LockPolicy,
+          template <class, class> class DocMap = Hash_Doc_Map>
+class Dictionary
+{
+public:
+    Dictionary() = default;
+
+    Dictionary(const dictionary_t& d)
+    {
+        init(d);
+    }
+
+    /// Insert the documents of d, in order so that the posting lists are in document order
+    void init(const dictionary_t& d)
+    {
+        for (const auto& [id, text] : d)
+            insert(id, text);
+    }
+
+    result_t search(const char* word) const
+    {
+        result_t r;
+        if (const posting_t* p = words_.find(word))
+            p->read(r);
+        return r;
+    }
+
+    void insert(int document_id, gsl::span<const char*> text)
+    {
+        // The document is locked until its words are all indexed
+        docs_.insert(document_id, [&](std::vector<posting_t*>& postings) {
+            for (const char* word : unique_words(text))
+            {
+                posting_t& p = words_.find_or_add(word);
+                p.insert(document_id);
+                postings.push_back(&p);
+            }
+        });
+    }
+
+    void remove(int document_id)
+    {
+        docs_.erase(document_id, [&](const std::vector<posting_t*>& postings) {
+            for (posting_t* p : postings)
+                p->erase(document_id);
+        });
+    }
+
+private:
+    // Posting list of a word with its lock
+    struct posting_t
+    {
+        void insert(int id)
+        {
+            typename LockPolicy::write_lock_t l(m);
+            list.insert(id);
+        }
+
+        void erase(int id)
+        {
+            typename LockPolicy::write_lock_t l(m);
+            list.erase(id);
+        }
+
+        void read(result_t& r) const
+        {
+            typename LockPolicy::read_lock_t l(m);
+            list.read(r);
+        }
+
+        mutable typename LockPolicy::mutex_t m;
+        PostingList                          list;
+    };
+
+    static std::vector<const char*> unique_words(gsl::span<const char*> text)
+    {
+        std::vector<const char*> words(text.begin(), text.end());
+        std::sort(words.begin(), words.end(), [](const char* a, const char* b) { return std::strcmp(a, b) < 0; });
+        words.erase(std::unique(words.begin(), words.end(),
+                                [](const char* a, const char* b) { return std::strcmp(a, b) == 0; }),
+                    words.end());
+        return words;
+    }
+
+    WordIndex<posting_t, LockPolicy>            words_;
+    DocMap<std::vector<posting_t*>, LockPolicy> docs_; // Posting lists of each document, to remove it
+};
+
+/// IReversedDictionary over a dictionary D whose methods are not virtual
+template <class D>
+class Virtual_Dictionary : public IReversedDictionary
+{
+public:
+    Virtual_Dictionary() = default;
+
+    Virtual_Dictionary(const dictionary_t& d)
+    {
+        dic_.init(d);
+    }
+
+    virtual void init(const dictionary_t& d) final
+    {
+        dic_.init(d);
+    }
+
+    virtual result_t search(const char* word) const final
+    {
+        return dic_.search(word);
+    }
+
+    virtual void insert(int document_id, gsl::span<const char*> text) final
+    {
+        dic_.insert(document_id, text);
+    }
+
+    virtual void remove(int document_id) final
+    {
+        dic_.remove(document_id);
+    }
+
+    /// The dictionary itself, to call it without the virtual functions
+    D& get()
+    {
+        return dic_;
+    }
+
+    const D& get() const
+    {
+        return dic_;
+    }
+
+private:
+    D dic_;
+};
+
+/// Combinations close to the dictionaries written by hand
+using Trie_Policy_Dictionary = Dictionary<Trie_Index, Vector_Postings, Shared_Mutex_Policy>;   // Tree_Dictionary
+using Hash_Policy_Dictionary = Dictionary<Hash_Index, Vector_Postings, Shared_Mutex_Policy>;   // hashmap_dictionary
+using Naive_Policy_Dictionary = Dictionary<Locked_Map_Index, Vector_Postings, Shared_Mutex_Policy, Locked_Doc_Map>; // naive_dictionary
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <tbb/concurrent_unordered_map.h>
+#include <unordered_map>
+
+/// Word indexes: map a word to a V of stable address, created on first use
+/// find() and find_or_add() may run concurrently. LockPolicy is the lock policy
+/// of the dictionary, for the indexes that lock.
+
+/// Trie of lowercase words, whose children are created with a compare and swap:
+/// neither find() nor find_or_add() locks
+template <class V, class LockPolicy>
+class Trie_Index
+{
+public:
+    const V* find(const char* word) const
+    {
+        const node_t* cur = &root_;
+        for (; *word != '\0'; ++word)
+        {
+            cur = cur->children[*word - 'a'].load(std::memory_order_acquire);
+            if (cur == nullptr)
+                return nullptr;
+        }
+        return cur->value.load(std::memory_order_acquire);
+    }
+
+    V& find_or_add(const char* word)
+    {
+        node_t* cur = &root_;
+        for (; *word != '\0'; ++word)
+            cur = get_or_add(cur->children[*word - 'a']);
+        return *get_or_add(cur->value);
+    }
+
+private:
+    static constexpr int NB_LETTERS = 26;
+
+    struct node_t
+    {
+        ~node_t()
+        {
+            for (auto& c : children)
+                delete c.load();
+            delete value.load();
+        }
+
+        std::atomic<node_t*> children[NB_LETTERS] = {};
+        std::atomic<V*>      value{nullptr};
+    };
+
+    // Create *slot if null, a thread losing the race deletes its copy
+    template <typename T>
+    static T* get_or_add(std::atomic<T*>& slot)
+    {
+        T* cur = slot.load(std::memory_order_acquire);
+        if (cur != nullptr)
+            return cur;
+
+        auto added = std::make_unique<T>();
+        if (slot.compare_exchange_strong(cur, added.get(), std::memory_order_acq_rel))
+            return added.release();
+        return cur;
+    }
+
+    node_t root_;
+};
+
+/// tbb::concurrent_unordered_map: a probe per search, but a std::string is built
+/// from the word each time
+template <class V, class LockPolicy>
+class Hash_Index
+{
+public:
+    const V* find(const char* word) const
+    {
+        const auto it = map_.find(word);
+        return it == map_.end() ? nullptr : it->second.get();
+    }
+
+    V& find_or_add(const char* word)
+    {
+        auto it = map_.find(word);
+        if (it == map_.end())
+            it = map_.insert({word, std::make_unique<V>()}).first;
+        return *it->second;
+    }
+
+private:
+    tbb::concurrent_unordered_map<std::string, std::unique_ptr<V>> map_;
+};
+
+/// std::unordered_map under a single mutex of the lock policy, as in the naive dictionary
+template <class V, class LockPolicy>
+class Locked_Map_Index
+{
+public:
+    const V* find(const char* word) const
+    {
+        typename LockPolicy::read_lock_t l(m_);
+        const auto it = map_.find(word);
+        return it == map_.end() ? nullptr : it->second.get();
+    }
+
+    V& find_or_add(const char* word)
+    {
+        typename LockPolicy::write_lock_t l(m_);
+        auto& v = map_[word];
+        if (v == nullptr)
+            v = std::make_unique<V>();
+        return *v;
+    }
+
+private:
+    mutable typename LockPolicy::mutex_t             m_;
+    std::unordered_map<std::string, std::unique_ptr<V>> map_;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+#include "../IDictionary.hpp"
+
+/// Dictionary split in shards by document id
+/// A document lives in the shard doc_id % n_shards: writes lock and touch that
+/// shard only, so the hot buckets, upper trie nodes and word locks of a single
+/// dictionary are split between the shards. A search goes to every shard and
+/// keeps the smallest ids of their matches.
+///
+/// The results differ from DICTIONARY for a word in more than MAX_RESULT_COUNT
+/// documents: DICTIONARY keeps the first ones indexed, the shards the smallest
+/// ids among the first ones indexed in each shard. The count is the same, and
+/// so are the matches if the documents are inserted in increasing id order.
+///
+/// A batch of searches goes to the shards in parallel, a TBB task each. A single
+/// search does too if parallel, but a lookup usually costs less than a task.
+template <typename DICTIONARY>
+class Sharded_Dictionary : public IReversedDictionary
+{
+public:
+    explicit Sharded_Dictionary(int n_shards = int(std::max(1u, std::thread::hardware_concurrency())),
+                                bool parallel = false)
+        : parallel_(parallel && n_shards > 1)
+    {
+        for (int i = 0; i < n_shards; ++i)
+            shards_.push_back(std::make_unique<DICTIONARY>());
+    }
+
+    Sharded_Dictionary(const dictionary_t& d)
+        : Sharded_Dictionary()
+    {
+        init(d);
+    }
+
+    virtual void init(const dictionary_t& d) final
+    {
+        std::vector<dictionary_t> parts(shards_.size());
+        for (auto& [id, text] : d)
+            parts[shard_of(id)].emplace(id, text);
+
+        tbb::parallel_for(std::size_t(0), shards_.size(), [&](std::size_t i) { shards_[i]->init(parts[i]); });
+    }
+
+    virtual result_t search(const char* word) const final
+    {
+        const auto search_shards = [this, word](const tbb::blocked_range<std::size_t>& shards, result_t r) {
+            for (std::size_t i = shards.begin(); i != shards.end(); ++i)
+                merge_results(r, shards_[i]->search(word));
+            return r;
+        };
+
+        const tbb::blocked_range<std::size_t> all(0, shards_.size(), 1);
+        if (!parallel_)
+            return search_shards(all, result_t{});
+        return tbb::parallel_reduce(
+            all, result_t{}, search_shards,
+            [](result_t a, const result_t& b) {
+                merge_results(a, b);
+                return a;
+            },
+            tbb::simple_partitioner());
+    }
+
+    /// Each shard searches the whole batch, then the results are merged word by word
+    virtual void search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const final
+    {
+        const std::size_t n = words.size();
+        std::vector<result_t> parts((shards_.size() - 1) * n); // Shard 0 writes to out
+
+        tbb::parallel_for(std::size_t(0), shards_.size(), [&](std::size_t i) {
+            shards_[i]->search_batch(words, i == 0 ? out : gsl::make_span(parts.data() + (i - 1) * n, n));
+        });
+
+        for (std::size_t i = 1; i < shards_.size(); ++i)
+            for (std::size_t j = 0; j < n; ++j)
+                merge_results(out[j], parts[(i - 1) * n + j]);
+    }
+
+    virtual void insert(int document_id, gsl::span<const char*> text) final
+    {
+        shards_[shard_of(document_id)]->insert(document_id, text);
+    }
+
+    virtual void remove(int document_id) final
+    {
+        shards_[shard_of(document_id)]->remove(document_id);
+    }
+
+    int shards() const
+    {
+        return int(shards_.size());
+    }
+
+private:
+    std::size_t shard_of(int doc_id) const
+    {
+        return unsigned(doc_id) % shards_.size();
+    }
+
+    const bool                               parallel_;
+    std::vector<std::unique_ptr<DICTIONARY>> shards_;
+};
@@ -1,5 +1,6 @@
 #include <functional>
 #include <gtest/gtest.h>
+#include <optional>
 #include <thread>
 
 #include "naive_implementation/naive_dictionary.hpp"
@@ -10,7 +11,16 @@
 #include "hashmap_implementation/hashmap_dictionary.hpp"
 #include "hashmap_implementation/hashmap.hpp"
 #include "async_implementation/async_dictionary.hpp"
+#include "async_implementation/queued_dictionary.hpp"
+#include "async_implementation/awaitable_dictionary.hpp"
+#include "async_implementation/shard_affine_dictionary.hpp"
 #include "fusion_implementation/fusion_dictionary.hpp"
+#include "policy_implementation/policy_dictionary.hpp"
+#include "sharded_implementation/sharded_dictionary.hpp"
+#include "mvcc_implementation/mvcc_dictionary.hpp"
+#include "left_right_implementation/left_right_dictionary.hpp"
+#include "lsm_implementation/lsm_dictionary.hpp"
+#include "adaptive_implementation/adaptive_dictionary.hpp"
 
 using namespace std::string_literals;
 // TODO
@@ -118,6 +128,483 @@ TEST(TrieDictionary, Basic)
     }
 }
 
+// Same word content behind different pointers must be indexed once
+TEST(TrieDictionary, DuplicateWords)
+{
+    std::string w1 = "massue", w2 = "massue", w3 = "mass";
+    const char* text[] = {w1.c_str(), "masseur", w2.c_str(), w3.c_str(), "massue"};
+
+    Tree_Dictionary dic;
+    dic.insert(42, text);
+    ASSERT_EQ(dic.search("massue").count(), 1);
+    ASSERT_EQ(dic.search("masseur").count(), 1);
+    ASSERT_EQ(dic.search("mass").count(), 1);
+    ASSERT_EQ(dic.search("mas").count(), 0);
+
+    dic.remove(42);
+    ASSERT_EQ(dic.search("massue").count(), 0);
+    ASSERT_EQ(dic.search("mass").count(), 0);
+}
+
+TEST(Tokenizer, Split)
+{
+    std::vector<char> buffer;
+    std::vector<const char*> words;
+
+    // Words across the 16 and 32 byte blocks, non-ASCII bytes and digits separate words
+    const std::string raw = "La MASSUE, du lamassu\nmassive-limace 42 caf\xc3\xa9 abracadabrantesque!Zebre";
+    tokenize(raw, buffer, words);
+
+    const std::vector<std::string> expected = {"la", "massue", "du", "lamassu", "massive", "limace",
+                                               "caf", "abracadabrantesque", "zebre"};
+    ASSERT_EQ(std::vector<std::string>(words.begin(), words.end()), expected);
+
+    tokenize("", buffer, words);
+    ASSERT_EQ(words.size(), 0u);
+    tokenize(" ,;", buffer, words);
+    ASSERT_EQ(words.size(), 0u);
+}
+
+TEST(TrieDictionary, InsertText)
+{
+    Tree_Dictionary dic;
+    dic.insert_text(0, "La massue, le lamasse et la Massive.");
+    dic.insert_text(1, "MASSUE\nlimace");
+
+    ASSERT_EQ(dic.search("massue").count(), 2);
+    ASSERT_EQ(dic.search("massive").count(), 1);
+    ASSERT_EQ(dic.search("limace").count(), 1);
+    ASSERT_EQ(dic.search("la").count(), 1);
+
+    dic.remove(0);
+    ASSERT_EQ(dic.search("massue").count(), 1);
+    ASSERT_EQ(dic.search("la").count(), 0);
+}
+
+// The parallel build of init gives the same trie as inserting the books one by one
+TEST(TrieDictionary, ParallelInit)
+{
+    dic_t d = {{"massue", "lamasse", "", "massive", "zebre"}, //
+               {"massue", "limace", "lamasse", "lamasse"}, //
+               {"limace", "", "lamassue", "massue", "abaque"}};
+    dictionary_t init;
+    for (std::size_t i = 0; i < d.size(); ++i)
+        init[int(i)] = gsl::make_span(d[i]);
+
+    Tree_Dictionary built = init, inserted;
+    for (const auto& [book, text] : init)
+        inserted.insert(book, text);
+
+    for (const char* word : {"massue", "lamasse", "", "massive", "zebre", "limace", "abaque", "mass"})
+        ASSERT_EQ(built.search(word), inserted.search(word)) << word;
+    ASSERT_EQ(built.search_prefix("ma"), inserted.search_prefix("ma"));
+    ASSERT_EQ(built.search_prefix(""), inserted.search_prefix(""));
+
+    built.remove(0);
+    ASSERT_EQ(built.search("massue").count(), 2);
+    ASSERT_EQ(built.search("zebre").count(), 0);
+    ASSERT_EQ(built.search("").count(), 1);
+    ASSERT_EQ(built.search_prefix("z").size(), 0u);
+}
+
+TEST(FusionDictionary, ConcurrentInsertSearch)
+{
+    // Enough distinct words for the word index to grow several times while inserting
+    constexpr int NB_THREADS = 4, NB_DOCS = 50, NB_WORDS = 100;
+    std::vector<std::string> words(NB_THREADS * NB_DOCS * NB_WORDS);
+    for (std::size_t i = 0; i < words.size(); ++i)
+        for (std::size_t n = i + 1; n > 0; n /= 26)
+            words[i] += char('a' + n % 26);
+
+    Fusion_Dictionary dic;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NB_THREADS; ++t)
+        threads.emplace_back([&, t] {
+            for (int d = 0; d < NB_DOCS; ++d)
+            {
+                const int doc = t * NB_DOCS + d;
+                std::vector<const char*> text;
+                for (int w = 0; w < NB_WORDS; ++w)
+                    text.push_back(words[doc * NB_WORDS + w].c_str());
+
+                dic.insert(doc, text);
+                for (const char* w : text)
+                    ASSERT_EQ(dic.search(w).count(), 1);
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    for (const auto& w : words)
+        ASSERT_EQ(dic.search(w.c_str()).count(), 1);
+    ASSERT_EQ(dic.search("notindexed").count(), 0);
+}
+
+TEST(FusionDictionary, ReuseRemoved)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}};
+
+    Fusion_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+    };
+
+    // The handles of 0 are released and taken again by 2
+    dic.remove(0);
+    dic.insert(2, gsl::make_span(d[1]));
+    ASSERT_EQ(dic.search("massue").count(), 2);
+    ASSERT_EQ(dic.search("lamasse").count(), 0);
+
+    // Indexing 1 again keeps a single copy of its handles
+    dic.init(dictionary_t{{1, gsl::make_span(d[0])}});
+    dic.remove(1);
+    ASSERT_EQ(dic.search("massue").count(), 1);
+    ASSERT_EQ(dic.search("massive").count(), 0);
+    ASSERT_EQ(dic.search("limace").count(), 1);
+}
+
+TEST(TrieDictionary, PrefixSearch)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue", "massue"}};
+
+    Tree_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+        {2, gsl::make_span(d[2])},
+    };
+
+    {
+        auto res = dic.search_prefix("mass");
+        ASSERT_EQ(res.size(), 2u);
+        ASSERT_EQ(res[0].first, "massue"s);
+        ASSERT_EQ(res[0].second.count(), 3);
+        ASSERT_EQ(res[1].first, "massive"s);
+        ASSERT_EQ(res[1].second.item(0).id(), 0);
+    }
+
+    ASSERT_EQ(dic.search_prefix("l").size(), 3u);
+    ASSERT_EQ(dic.search_prefix("l", 1).size(), 1u);
+    ASSERT_EQ(dic.search_prefix("l", 1)[0].first, "limace"s);
+    ASSERT_EQ(dic.search_prefix("massues").size(), 0u);
+    ASSERT_EQ(dic.search_prefix("z").size(), 0u);
+
+    // Removed words are no longer completed
+    {
+        dic.remove(0);
+        auto res = dic.search_prefix("mass");
+        ASSERT_EQ(res.size(), 1u);
+        ASSERT_EQ(res[0].second.count(), 2);
+        ASSERT_EQ(dic.search_prefix("").size(), 3u);
+    }
+}
+
+TEST(TrieDictionary, ConcurrentPrefixSearch)
+{
+    // Words sharing their paths, so that the summaries are raised and lowered at once
+    dic_t d = {{"ma", "mas", "masse", "massue"}, //
+               {"mas", "massive", "lamasse"},    //
+               {"massue", "limace", "lamassue"}};
+    constexpr int NB_THREADS = 4, NB_ROUNDS = 500;
+
+    Tree_Dictionary dic;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NB_THREADS; ++t)
+        threads.emplace_back([&, t] {
+            for (int k = 0; k < NB_ROUNDS; ++k)
+            {
+                const int doc = t * NB_ROUNDS + k;
+                dic.insert(doc, gsl::make_span(d[doc % d.size()]));
+                if (k > 0)
+                    dic.remove(doc - 1);
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    // Each remaining word is reached from the root, with its documents
+    std::unordered_map<std::string, int> expected;
+    for (int t = 0; t < NB_THREADS; ++t)
+    {
+        const int doc = t * NB_ROUNDS + NB_ROUNDS - 1;
+        for (const char* w : d[doc % d.size()])
+            expected[w]++;
+    }
+    const auto res = dic.search_prefix("", 100);
+    ASSERT_EQ(res.size(), expected.size());
+    for (const auto& [word, books] : res)
+        ASSERT_EQ(books.count(), expected[word]);
+}
+
+// Concurrent inserts of the same document index it once
+TEST(TrieDictionary, ConcurrentDuplicateInsert)
+{
+    const char* text[] = {"massue", "limace"};
+    constexpr int NB_THREADS = 4, NB_DOCS = 500;
+
+    Tree_Dictionary dic;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NB_THREADS; ++t)
+        threads.emplace_back([&] {
+            for (int doc = 0; doc < NB_DOCS; ++doc)
+                dic.insert(doc, text);
+        });
+    for (auto& t : threads)
+        t.join();
+
+    for (int doc = 0; doc < NB_DOCS - 1; ++doc)
+        dic.remove(doc);
+    ASSERT_EQ(dic.search("massue").count(), 1);
+    ASSERT_EQ(dic.search("limace").item(0).id(), NB_DOCS - 1);
+    dic.remove(NB_DOCS - 1);
+    ASSERT_EQ(dic.search("massue").count(), 0);
+}
+
+TEST(TrieDictionary, FuzzySearch)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue"}};
+
+    Tree_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+        {2, gsl::make_span(d[2])},
+    };
+
+    ASSERT_EQ(dic.search_fuzzy("massue", 0).size(), 1u);
+    ASSERT_EQ(dic.search_fuzzy("masue", 0).size(), 0u);
+    ASSERT_EQ(dic.search_fuzzy("masue", 1)[0].first, "massue"s);  // deletion
+    ASSERT_EQ(dic.search_fuzzy("mmassue", 1)[0].first, "massue"s); // insertion
+    ASSERT_EQ(dic.search_fuzzy("lamace", 1)[0].first, "limace"s);  // substitution
+    ASSERT_EQ(dic.search_fuzzy("ilmace", 1)[0].first, "limace"s);  // transposition
+    ASSERT_EQ(dic.search_fuzzy("ilmace", 1)[0].second.count(), 2);
+
+    {
+        // Closest first
+        auto res = dic.search_fuzzy("lamassuee", 2);
+        ASSERT_EQ(res.size(), 2u);
+        ASSERT_EQ(res[0].first, "lamassue"s);
+        ASSERT_EQ(res[1].first, "lamasse"s);
+    }
+
+    dic.remove(2);
+    ASSERT_EQ(dic.search_fuzzy("lamassuee", 2).size(), 1u);
+}
+
+TEST(TrieDictionary, Freeze)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue"}};
+
+    Tree_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+        {2, gsl::make_span(d[2])},
+    };
+    dic.remove(1);
+
+    const Frozen_Dictionary frozen = dic.freeze();
+    for (const char* word : {"massue", "lamasse", "massive", "limace", "lamassue", "mass", "masseur", ""})
+        ASSERT_EQ(frozen.search(word), dic.search(word)) << word;
+
+    // Unlike the trie, the frozen copy accepts any byte
+    ASSERT_EQ(frozen.search("Massue!").count(), 0);
+
+    // The frozen copy does not see later updates
+    const char* text[] = {"masseur"};
+    dic.insert(42, text);
+    ASSERT_EQ(frozen.search("masseur").count(), 0);
+}
+
+// A long scenario, check that the frozen dictionary answers like the trie
+TEST(FusionDictionary, FreezeConsistency)
+{
+    Scenario::param_t params;
+    params.word_count = 10000;
+    params.doc_count = 100;
+    params.word_redoundancy = 0.1f;
+    params.word_occupancy = 0.9f;
+    params.n_queries = 10000;
+    params.ratio_indel = 0.;
+
+    Scenario scn(params);
+
+    Fusion_Dictionary dic;
+    scn.prepare(dic);
+    const Frozen_Dictionary frozen = dic.freeze();
+
+    for (const char* word : scn.searches())
+        ASSERT_EQ(frozen.search(word), dic.search(word)) << word;
+}
+
+// search_batch gives the results of search, for batches of any size and missing words
+template <typename DICTIONARY>
+void check_search_batch()
+{
+    Scenario::param_t params;
+    params.word_count = 10000;
+    params.doc_count = 100;
+    params.word_redoundancy = 0.1f;
+    params.word_occupancy = 0.9f;
+    params.n_queries = 10000;
+    params.ratio_indel = 0.;
+
+    Scenario scn(params);
+
+    DICTIONARY dic;
+    scn.prepare(dic);
+
+    std::vector<const char*> words = scn.searches();
+    words.push_back("zzzzzz");
+    words.push_back("");
+    std::vector<result_t> out(words.size());
+    for (std::size_t size : {std::size_t(1), std::size_t(7), std::size_t(16), words.size()})
+    {
+        const std::size_t n = std::min(size, words.size());
+        dic.search_batch(gsl::make_span(words.data(), n), gsl::make_span(out.data(), n));
+        for (std::size_t i = 0; i < n; ++i)
+            ASSERT_EQ(out[i], dic.search(words[i])) << words[i];
+    }
+}
+
+TEST(TrieDictionary, SearchBatch)
+{
+    check_search_batch<Tree_Dictionary>();
+}
+
+TEST(FusionDictionary, SearchBatch)
+{
+    check_search_batch<Fusion_Dictionary>();
+}
+
+TEST(HashmapDictionary, SearchBatch)
+{
+    check_search_batch<hashmap_dictionary>();
+}
+
+// Prepared handles see the inserts and removes, and handles of another dictionary
+// or of missing words fall back to a lookup
+template <typename DICTIONARY>
+void check_prepared()
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue"}};
+
+    DICTIONARY dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+    };
+    DICTIONARY other;
+
+    const prepared_t massue = dic.prepare("massue");
+    const prepared_t limace = dic.prepare("limace");
+    const prepared_t lamassue = dic.prepare("lamassue");
+    const prepared_t foreign = other.prepare("massue");
+    ASSERT_EQ(dic.search_prepared(massue).count(), 2);
+    ASSERT_EQ(dic.search_prepared(limace).count(), 1);
+    ASSERT_EQ(dic.search_prepared(lamassue).count(), 0);
+    ASSERT_EQ(dic.search_prepared(foreign).count(), 2);
+
+    dic.insert(2, d[2]);
+    dic.remove(0);
+    for (const prepared_t* q : {&massue, &limace, &lamassue, &foreign})
+        ASSERT_EQ(dic.search_prepared(*q), dic.search(q->word.c_str())) << q->word;
+    ASSERT_EQ(dic.search_prepared(limace).count(), 2);
+
+    dic.remove(1);
+    ASSERT_EQ(dic.search_prepared(massue).count(), 0);
+    dic.insert(3, d[1]);
+    ASSERT_EQ(dic.search_prepared(massue).count(), 1);
+    ASSERT_EQ(dic.search_prepared(massue).item(0).id(), 3);
+
+    // A dictionary built at the address of a destroyed one does not take its handles
+    std::optional<DICTIONARY> reused;
+    reused.emplace(dictionary_t{{0, gsl::make_span(d[0])}});
+    const prepared_t stale = reused->prepare("massue");
+    reused.emplace(dictionary_t{{4, gsl::make_span(d[1])}, {5, gsl::make_span(d[1])}});
+    ASSERT_EQ(reused->search_prepared(stale).count(), 2);
+}
+
+TEST(TrieDictionary, Prepared)
+{
+    check_prepared<Tree_Dictionary>();
+}
+
+TEST(FusionDictionary, Prepared)
+{
+    check_prepared<Fusion_Dictionary>();
+}
+
+TEST(HashmapDictionary, Prepared)
+{
+    check_prepared<hashmap_dictionary>();
+}
+
+// A handle keeps a removed node alive and sees it removed
+TEST(HashMap, RemovedNode)
+{
+    hashmap<int, std::vector<int>> map;
+    map.insert_value(1, 42);
+    const auto node = map.find_node_unlocked(1);
+    ASSERT_TRUE(node->read_value([](const std::vector<int>& v) { ASSERT_EQ(v.at(0), 42); }));
+
+    map.remove(1);
+    ASSERT_EQ(map.find_node_unlocked(1), nullptr);
+    ASSERT_FALSE(node->read_value([](const std::vector<int>&) {}));
+}
+
+// Hot words are served from the relayouted table and still see the updates
+TEST(TrieDictionary, HotPaths)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue"}};
+
+    Tree_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+        {2, gsl::make_span(d[2])},
+    };
+
+    for (int i = 0; i < 100 * Hot_Paths::SAMPLE_PERIOD; ++i)
+        dic.search(i % 2 ? "massue" : "limace");
+    dic.relayout();
+
+    ASSERT_EQ(dic.search("massue").count(), 2);
+    ASSERT_EQ(dic.search("limace").count(), 2);
+    ASSERT_EQ(dic.search("lamasse").count(), 1);
+    ASSERT_EQ(dic.search("mass").count(), 0);
+
+    const char* text[] = {"massue"};
+    dic.insert(42, text);
+    ASSERT_EQ(dic.search("massue").count(), 3);
+
+    dic.remove(1);
+    ASSERT_EQ(dic.search("massue").count(), 2);
+    ASSERT_EQ(dic.search("limace").count(), 1);
+    ASSERT_EQ(dic.search("limace").item(0).id(), 2);
+}
+
+// The relayouts due to the sampling run aside, the searches go on meanwhile
+TEST(TrieDictionary, SampledRelayout)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}};
+
+    Tree_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+    };
+
+    for (int i = 0; i < 2 * Hot_Paths::SAMPLE_PERIOD * Hot_Paths::RELAYOUT_PERIOD; ++i)
+        ASSERT_EQ(dic.search(i % 2 ? "massue" : "limace").count(), i % 2 ? 2 : 1);
+}
+
 TEST(FusionDictionary, Basic)
 {
     dic_t d = {{"massue", "lamasse", "massive"}, //
@@ -158,6 +645,29 @@ TEST(FusionDictionary, Basic)
     }
 }
 
+TEST(FusionDictionary, PrefixSearch)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}};
+
+    Fusion_Dictionary dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+    };
+
+    const char* text[] = {"massif"};
+    dic.insert(42, text);
+
+    auto res = dic.search_prefix("mass");
+    ASSERT_EQ(res.size(), 3u);
+    ASSERT_EQ(res[0].first, "massue"s);
+
+    dic.remove(42);
+    dic.remove(1);
+    ASSERT_EQ(dic.search_prefix("mass").size(), 2u);
+    ASSERT_EQ(dic.search_prefix("li").size(), 0u);
+}
+
 TEST(Dictionary, Basic)
 {
     dic_t d = {{"massue", "lamasse", "massive"}, //
@@ -304,4 +814,926 @@ TEST(HashmapDictionary, AsyncConsistency)
   auto r1 = scn.execute(async_dic, 1);
   auto r2 = scn.execute(dic);
   ASSERT_EQ(r1, r2);
-}
\ No newline at end of file
+}
+TEST(ThreadPool, Lanes)
+{
+  constexpr int NB_TASKS = 10000;
+  std::atomic<int> reads = 0, writes = 0;
+  {
+    Thread_Pool pool(2, 2);
+    for (int i = 0; i < NB_TASKS; ++i)
+    {
+      pool.push([&] { ++reads; });
+      pool.push_write([&] { ++writes; });
+    }
+    pool.wait();
+    ASSERT_EQ(reads, NB_TASKS);
+    ASSERT_EQ(writes, NB_TASKS);
+
+    // The pool waits for its tasks when destroyed
+    for (int i = 0; i < NB_TASKS; ++i)
+      pool.push_write([&] { ++writes; });
+  }
+  ASSERT_EQ(writes, 2 * NB_TASKS);
+}
+
+// Scenario the dictionaries are checked against a reference on
+Scenario::param_t consistency_params()
+{
+    Scenario::param_t params;
+    params.word_count = 1000;
+    params.doc_count = 30;
+    params.word_redoundancy = 0.3f;
+    params.word_occupancy = 0.9f;
+    params.n_queries = 10000;
+    params.ratio_indel = 0.2;
+    return params;
+}
+
+// dic gives the results of REFERENCE on the consistency scenario
+// prepared(dic) is called between the preparation and the execution
+template <typename DICTIONARY, typename REFERENCE = Tree_Dictionary, typename F>
+void check_consistency(DICTIONARY& dic, F prepared)
+{
+    Scenario scn(consistency_params());
+
+    REFERENCE ref;
+    scn.prepare(ref);
+    scn.prepare(dic);
+    prepared(dic);
+    ASSERT_EQ(scn.execute(dic), scn.execute(ref));
+}
+
+template <typename DICTIONARY, typename REFERENCE = Tree_Dictionary>
+void check_consistency(DICTIONARY& dic)
+{
+    check_consistency<DICTIONARY, REFERENCE>(dic, [](DICTIONARY&) {});
+}
+
+TEST(TrieDictionary, ShardAffineConsistency)
+{
+    Scenario scn(consistency_params());
+
+    Tree_Dictionary dic;
+    Shard_Affine_Dictionary<Tree_Dictionary> sharded_dic(4, false);
+    scn.prepare(dic);
+    scn.prepare(sharded_dic);
+    auto r1 = scn.execute(sharded_dic, 1);
+    auto r2 = scn.execute(dic);
+    ASSERT_EQ(r1.size(), r2.size());
+
+    // The shards keep the smallest ids of their own matches: the same matches
+    // unless some were dropped by the MAX_RESULT_COUNT limit
+    auto by_id = [](match_t a, match_t b) { return a.id() < b.id(); };
+    for (std::size_t i = 0; i < r1.size(); ++i)
+    {
+        ASSERT_EQ(r1[i].count(), r2[i].count());
+        if (r2[i].count() < MAX_RESULT_COUNT)
+        {
+            std::sort(r2[i].m_matched, r2[i].m_matched + r2[i].m_count, by_id);
+            ASSERT_EQ(r1[i], r2[i]);
+        }
+    }
+}
+
+// The shards keep the smallest ids of their own matches: the same matches as
+// DICTIONARY unless some were dropped by the MAX_RESULT_COUNT limit
+template <typename DICTIONARY>
+void check_sharded(bool parallel)
+{
+    Scenario scn(consistency_params());
+
+    DICTIONARY dic;
+    Sharded_Dictionary<DICTIONARY> sharded_dic(4, parallel);
+    scn.prepare(dic);
+    scn.prepare(sharded_dic);
+    auto r1 = scn.execute(sharded_dic);
+    auto r2 = scn.execute(dic);
+    ASSERT_EQ(r1.size(), r2.size());
+
+    auto by_id = [](match_t a, match_t b) { return a.id() < b.id(); };
+    for (std::size_t i = 0; i < r1.size(); ++i)
+    {
+        ASSERT_EQ(r1[i].count(), r2[i].count());
+        if (r2[i].count() < MAX_RESULT_COUNT)
+        {
+            std::sort(r2[i].m_matched, r2[i].m_matched + r2[i].m_count, by_id);
+            ASSERT_EQ(r1[i], r2[i]);
+        }
+    }
+
+    const auto words = scn.searches();
+    std::vector<result_t> out(words.size());
+    sharded_dic.search_batch(words, out);
+    for (std::size_t i = 0; i < words.size(); ++i)
+        ASSERT_EQ(out[i], sharded_dic.search(words[i])) << words[i];
+}
+
+TEST(TrieDictionary, ShardedConsistency)
+{
+    check_sharded<Tree_Dictionary>(true);
+    check_sharded<Tree_Dictionary>(false);
+}
+
+TEST(FusionDictionary, ShardedConsistency)
+{
+    check_sharded<Fusion_Dictionary>(true);
+}
+
+TEST(HashmapDictionary, ShardedConsistency)
+{
+    check_sharded<hashmap_dictionary>(true);
+}
+
+// Beyond MAX_RESULT_COUNT matches, the shards keep the smallest ids among the
+// first documents indexed in each of them
+TEST(TrieDictionary, ShardedManyMatches)
+{
+    constexpr int NB_DOCS = 8 * MAX_RESULT_COUNT;
+    const char* text[] = {"massue"};
+    auto by_id  = [](match_t a, match_t b) { return a.id() < b.id(); };
+    auto sorted = [&](result_t r) {
+        std::sort(r.m_matched, r.m_matched + r.m_count, by_id);
+        return r;
+    };
+
+    // Inserted in increasing id order: the smallest ids, as Tree_Dictionary
+    {
+        Tree_Dictionary dic;
+        Sharded_Dictionary<Tree_Dictionary> sharded_dic(4);
+        for (int id = 0; id < NB_DOCS; ++id)
+        {
+            dic.insert(id, text);
+            sharded_dic.insert(id, text);
+        }
+        const result_t r = sharded_dic.search("massue");
+        ASSERT_EQ(r.count(), MAX_RESULT_COUNT);
+        ASSERT_EQ(r, sorted(dic.search("massue")));
+        for (int i = 0; i < MAX_RESULT_COUNT; ++i)
+            ASSERT_EQ(r.item(i).id(), i);
+    }
+
+    // Inserted in decreasing id order: Tree_Dictionary keeps the first inserted,
+    // the largest ids, while each shard keeps its largest and the merge their smallest
+    {
+        Tree_Dictionary dic;
+        Sharded_Dictionary<Tree_Dictionary> sharded_dic(4);
+        for (int id = NB_DOCS - 1; id >= 0; --id)
+        {
+            dic.insert(id, text);
+            sharded_dic.insert(id, text);
+        }
+        const result_t expected = sorted(dic.search("massue"));
+        const result_t r = sharded_dic.search("massue");
+        ASSERT_EQ(r.count(), expected.count());
+        for (int i = 0; i < MAX_RESULT_COUNT; ++i)
+        {
+            ASSERT_EQ(expected.item(i).id(), NB_DOCS - MAX_RESULT_COUNT + i);
+            ASSERT_EQ(r.item(i).id(), NB_DOCS - 4 * MAX_RESULT_COUNT + i);
+        }
+    }
+}
+
+TEST(ThreadPool, IsolatedPinned)
+{
+  executor_config_t config;
+  config.read_workers = 2;
+  config.write_workers = 1;
+  config.cpus = {0};
+  config.isolated = true;
+
+  std::atomic<int> done = 0, off_cpu = 0;
+  {
+    Thread_Pool pool(config);
+    for (int i = 0; i < 1000; ++i)
+    {
+      pool.push([&] {
+#ifdef __linux__
+        off_cpu += sched_getcpu() != 0;
+#endif
+        ++done;
+      });
+      pool.push_write([&] { ++done; });
+    }
+  }
+  ASSERT_EQ(done, 2000);
+  ASSERT_EQ(off_cpu, 0);
+}
+
+TEST(TrieDictionary, ExecutorConsistency)
+{
+    Scenario scn(consistency_params());
+
+    executor_config_t config;
+    config.cpus = {0};
+
+    Tree_Dictionary dic;
+    Async_Dictionary<Tree_Dictionary> pinned_dic(config);
+    config.isolated = true;
+    Async_Dictionary<Tree_Dictionary> isolated_dic(config);
+    scn.prepare(dic);
+    scn.prepare(pinned_dic);
+    scn.prepare(isolated_dic);
+    auto r1 = scn.execute(dic);
+    ASSERT_EQ(scn.execute(pinned_dic, 1), r1);
+    ASSERT_EQ(scn.execute(isolated_dic, 1), r1);
+}
+
+TEST(TrieDictionary, CoalescedWrites)
+{
+  std::vector<const char*> a = {"apple", "banana"}, b = {"cherry"};
+  Tree_Dictionary dic;
+  Thread_Pool pool(1, 1);
+  Write_Coalescer<Tree_Dictionary> writes(dic, pool);
+
+  // Hold the write lane so that the writes below wait together
+  std::atomic<bool> hold = true;
+  pool.push_write([&] {
+    while (hold)
+      std::this_thread::yield();
+  });
+
+  std::vector<std::future<void>> done;
+  auto submit = [&](auto f) {
+    auto p = new std::promise<void>;
+    done.push_back(p->get_future());
+    f(p);
+  };
+  submit([&](auto p) { writes.insert(1, a, p); });
+  submit([&](auto p) { writes.remove(1, p); });
+  submit([&](auto p) { writes.insert(1, b, p); });
+  submit([&](auto p) { writes.insert(1, a, p); });
+  submit([&](auto p) { writes.insert(2, a, p); });
+  submit([&](auto p) { writes.insert(2, b, p); });
+  hold = false;
+  for (auto& f : done)
+    f.get();
+
+  // 1: remove then insert b, 2: insert a
+  ASSERT_EQ(writes.submitted(), 6u);
+  ASSERT_EQ(writes.applied(), 3u);
+  ASSERT_EQ(dic.search("cherry").count(), 1);
+  ASSERT_EQ(dic.search("cherry").item(0).id(), 1);
+  ASSERT_EQ(dic.search("apple").count(), 1);
+  ASSERT_EQ(dic.search("apple").item(0).id(), 2);
+}
+
+// Tree_Dictionary whose searches wait for the gate to be open
+struct Gated_Dictionary
+{
+  static inline std::atomic<bool> open = true;
+
+  void init(const dictionary_t& d) { dic.init(d); }
+  void insert(int document_id, gsl::span<const char*> text) { dic.insert(document_id, text); }
+  void remove(int document_id) { dic.remove(document_id); }
+
+  result_t search(const char* word) const
+  {
+    while (!open)
+      std::this_thread::yield();
+    return dic.search(word);
+  }
+
+  Tree_Dictionary dic;
+};
+
+TEST(AsyncDictionary, Admission)
+{
+  executor_config_t config;
+  config.read_workers = 1;
+  config.isolated = true;
+
+  for (auto policy : {overload_policy::reject, overload_policy::drop_oldest_read})
+  {
+    admission_config_t admission;
+    admission.max_reads = 2;
+    admission.policy = policy;
+    Async_Dictionary<Gated_Dictionary> dic(config, admission);
+
+    // The worker takes the first search and waits, two more fill the queue
+    Gated_Dictionary::open = false;
+    std::vector<std::future<result_t>> searches;
+    searches.push_back(dic.search("a"));
+    while (dic.stats().read_depth > 0)
+      std::this_thread::yield();
+    searches.push_back(dic.search("b"));
+    searches.push_back(dic.search("c"));
+    ASSERT_EQ(dic.stats().read_depth, 2u);
+
+    searches.push_back(dic.search("d"));
+    Gated_Dictionary::open = true;
+
+    // Rejected: the new search, dropped: the oldest queued one
+    const std::size_t failed = policy == overload_policy::reject ? 3 : 1;
+    for (std::size_t i = 0; i < searches.size(); ++i)
+      if (i == failed)
+        ASSERT_THROW(searches[i].get(), overload_error);
+      else
+        ASSERT_NO_THROW(searches[i].get());
+
+    const auto stats = dic.stats();
+    ASSERT_EQ(stats.rejected, policy == overload_policy::reject ? 1u : 0u);
+    ASSERT_EQ(stats.dropped, policy == overload_policy::drop_oldest_read ? 1u : 0u);
+  }
+}
+
+TEST(AsyncDictionary, Timings)
+{
+  Scenario::param_t params;
+  params.word_count = 1000;
+  params.doc_count = 30;
+  params.word_redoundancy = 0.3f;
+  params.word_occupancy = 0.9f;
+  params.n_queries = 10000;
+  params.ratio_indel = 0.2;
+
+  Scenario scn(params);
+
+  Async_Dictionary<Tree_Dictionary> dic;
+  dic.trace_handoff(true);
+  scn.prepare(dic);
+  const auto results = scn.execute(dic, 64);
+  while (dic.stats().write_depth > 0)
+    std::this_thread::yield();
+
+  const auto t = dic.timings();
+  for (auto p : {phase::queued, phase::execution, phase::handoff})
+    ASSERT_EQ(t.of(request_t::search, p).count, results.size());
+  ASSERT_EQ(t.of(request_t::insert, phase::queued).count + t.of(request_t::remove, phase::queued).count,
+            params.n_queries - results.size());
+  // Scenario does not get() every write future
+  ASSERT_LE(t.of(request_t::insert, phase::handoff).count + t.of(request_t::remove, phase::handoff).count,
+            params.n_queries - results.size());
+
+  const auto& search = t.of(request_t::search, phase::execution);
+  ASSERT_GT(search.mean_ns(), 0.);
+  ASSERT_LE(search.quantile_ns(0.5), search.quantile_ns(0.99));
+  ASSERT_GT(t.busy_ratio(), 0.);
+}
+
+// Every combination of policies gives the results of Tree_Dictionary
+template <typename DICTIONARY>
+void check_policy_dictionary()
+{
+    Virtual_Dictionary<DICTIONARY> policy_dic;
+    check_consistency(policy_dic);
+}
+
+TEST(PolicyDictionary, Combinations)
+{
+    check_policy_dictionary<Trie_Policy_Dictionary>();
+    check_policy_dictionary<Hash_Policy_Dictionary>();
+    check_policy_dictionary<Naive_Policy_Dictionary>();
+    check_policy_dictionary<Dictionary<Trie_Index, Head_Postings, Spin_Policy>>();
+    check_policy_dictionary<Dictionary<Hash_Index, Head_Postings, No_Lock_Policy>>();
+    check_policy_dictionary<Dictionary<Trie_Index, Head_Postings, Spin_Policy, Locked_Doc_Map>>();
+}
+
+TEST(PolicyDictionary, HeadPostings)
+{
+    Head_Postings p;
+    for (int id = 0; id < 15; ++id)
+        p.insert(id);
+    p.erase(3);
+    p.erase(12);
+    p.erase(0);
+
+    result_t r;
+    p.read(r);
+    const std::vector<int> expected = {1, 2, 4, 5, 6, 7, 8, 9, 10, 11};
+    ASSERT_EQ(r.count(), 10);
+    for (int i = 0; i < r.count(); ++i)
+        ASSERT_EQ(r.item(i).id(), expected[i]);
+}
+
+TEST(PolicyDictionary, AsyncConsistency)
+{
+    Scenario::param_t params;
+    params.word_count = 1000;
+    params.doc_count = 30;
+    params.word_redoundancy = 0.3f;
+    params.word_occupancy = 0.9f;
+    params.n_queries = 10000;
+    params.ratio_indel = 0.2;
+
+    Scenario scn(params);
+
+    Virtual_Dictionary<Trie_Policy_Dictionary> dic;
+    Async_Dictionary<Trie_Policy_Dictionary> async_dic;
+    scn.prepare(dic);
+    scn.prepare(async_dic);
+    auto r1 = scn.execute(async_dic, 1);
+    auto r2 = scn.execute(dic);
+    ASSERT_EQ(r1, r2);
+}
+
+TEST(MvccDictionary, Consistency)
+{
+    Mvcc_Dictionary<> mvcc_dic;
+    check_consistency(mvcc_dic);
+}
+
+// A snapshot keeps seeing the state it was taken at, and the removed entries
+// are collected once it is gone
+TEST(MvccDictionary, Snapshot)
+{
+    dic_t d = {{"massue", "lamasse", "massive"}, //
+               {"massue", "limace"}, //
+               {"limace", "lamassue"}};
+
+    Mvcc_Dictionary<> dic = dictionary_t{
+        {0, gsl::make_span(d[0])},
+        {1, gsl::make_span(d[1])},
+    };
+
+    {
+        const auto before = dic.snapshot();
+        dic.insert(2, d[2]);
+        dic.remove(0);
+
+        ASSERT_EQ(before.search("massue").count(), 2);
+        ASSERT_EQ(before.search("limace").count(), 1);
+        ASSERT_EQ(before.search("lamassue").count(), 0);
+
+        const auto after = dic.snapshot();
+        ASSERT_GT(after.version(), before.version());
+        ASSERT_EQ(after.search("massue").count(), 1);
+        ASSERT_EQ(after.search("limace").count(), 2);
+        ASSERT_EQ(after.search("lamassue").count(), 1);
+
+        dic.collect();
+        ASSERT_EQ(dic.garbage(), 3u); // massue, lamasse and massive of document 0
+        ASSERT_EQ(before.search("lamasse").count(), 1);
+    }
+
+    dic.collect();
+    ASSERT_EQ(dic.garbage(), 0u);
+    ASSERT_EQ(dic.search("lamasse").count(), 0);
+    ASSERT_EQ(dic.search("massue").item(0).id(), 1);
+}
+
+// Every document holds both words: a snapshot sees them in the same documents,
+// while they are inserted and removed
+TEST(MvccDictionary, ConcurrentSnapshots)
+{
+    Mvcc_Dictionary<Trie_Index> dic;
+    std::atomic<bool> done{false};
+
+    std::thread writer([&] {
+        const char* text[] = {"alpha", "beta"};
+        for (int i = 0; i < 20000; ++i)
+        {
+            dic.insert(i, text);
+            if (i >= 5)
+                dic.remove(i - 5);
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t)
+        readers.emplace_back([&] {
+            while (!done)
+            {
+                const auto s = dic.snapshot();
+                const result_t alpha = s.search("alpha");
+                std::this_thread::yield();
+                ASSERT_EQ(alpha, s.search("beta"));
+                ASSERT_LE(alpha.count(), 6);
+            }
+        });
+
+    writer.join();
+    for (auto& r : readers)
+        r.join();
+    dic.collect();
+    ASSERT_EQ(dic.search("alpha").count(), 5);
+    ASSERT_EQ(dic.garbage(), 0u);
+}
+
+template <typename DICTIONARY>
+void check_left_right()
+{
+    Left_Right_Dictionary<DICTIONARY> left_right_dic;
+    check_consistency(left_right_dic);
+}
+
+TEST(LeftRightDictionary, Consistency)
+{
+    check_left_right<Tree_Dictionary>();
+    check_left_right<Dictionary<Trie_Index, Head_Postings, No_Lock_Policy>>();
+}
+
+// Readers search copies that lock nothing while a writer updates them
+TEST(LeftRightDictionary, ConcurrentReads)
+{
+    Left_Right_Dictionary<Dictionary<Trie_Index, Vector_Postings, No_Lock_Policy>> dic;
+    std::atomic<bool> done{false};
+
+    std::thread writer([&] {
+        const char* text[] = {"alpha", "beta"};
+        for (int i = 0; i < 5000; ++i)
+        {
+            dic.insert(i, text);
+            if (i >= 5)
+                dic.remove(i - 5);
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t)
+        readers.emplace_back([&] {
+            while (!done)
+            {
+                const result_t r = dic.search("alpha");
+                ASSERT_GE(r.count(), 1);
+                ASSERT_LE(r.count(), 6);
+            }
+        });
+
+    writer.join();
+    for (auto& r : readers)
+        r.join();
+    const result_t r = dic.search("beta");
+    ASSERT_EQ(r.count(), 5);
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(r.item(i).id(), 4995 + i);
+}
+
+void check_lsm(std::size_t merge_threshold, bool background)
+{
+    Lsm_Dictionary lsm_dic(merge_threshold, background);
+    check_consistency(lsm_dic);
+}
+
+TEST(LsmDictionary, Consistency)
+{
+    check_lsm(Lsm_Dictionary::MERGE_THRESHOLD, false); // Every write in the delta
+    check_lsm(16, true);
+}
+
+// Documents removed and inserted again across a merge
+TEST(LsmDictionary, Merge)
+{
+    const auto ids = [](const result_t& r) {
+        std::vector<int> v;
+        for (const match_t& m : r.items())
+            v.push_back(m.id());
+        return v;
+    };
+    const char* a[] = {"alpha", "beta"};
+    const char* b[] = {"alpha"};
+    Lsm_Dictionary dic(Lsm_Dictionary::MERGE_THRESHOLD, false);
+    dic.init({{1, a}, {2, a}, {3, b}});
+    ASSERT_EQ(dic.merges(), 1u);
+
+    dic.remove(2);
+    dic.insert(4, a);
+    dic.insert(2, b);
+    ASSERT_EQ(dic.delta_size(), 3u);
+    ASSERT_EQ(ids(dic.search("alpha")), (std::vector<int>{1, 3, 4, 2}));
+    ASSERT_EQ(ids(dic.search("beta")), (std::vector<int>{1, 4}));
+
+    dic.merge();
+    ASSERT_EQ(dic.merges(), 2u);
+    ASSERT_EQ(dic.delta_size(), 0u);
+    dic.remove(1);
+    ASSERT_EQ(ids(dic.search("alpha")), (std::vector<int>{3, 4, 2}));
+    ASSERT_EQ(ids(dic.search("beta")), (std::vector<int>{4}));
+
+    dic.merge();
+    dic.merge(); // Nothing to fold
+    ASSERT_EQ(dic.merges(), 3u);
+    ASSERT_EQ(ids(dic.search("alpha")), (std::vector<int>{3, 4, 2}));
+}
+
+// Readers search while a writer fills deltas the merger folds in the background
+TEST(LsmDictionary, ConcurrentMerges)
+{
+    Lsm_Dictionary dic(64);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&] {
+        const char* text[] = {"alpha", "beta"};
+        for (int i = 0; i < 5000; ++i)
+        {
+            dic.insert(i, text);
+            if (i >= 5)
+                dic.remove(i - 5);
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t)
+        readers.emplace_back([&] {
+            while (!done)
+            {
+                const result_t r = dic.search("alpha");
+                ASSERT_GE(r.count(), 1);
+                ASSERT_LE(r.count(), 6);
+            }
+        });
+
+    writer.join();
+    for (auto& r : readers)
+        r.join();
+    dic.merge();
+    const result_t r = dic.search("beta");
+    ASSERT_EQ(r.count(), 5);
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(r.item(i).id(), 4995 + i);
+}
+
+// Searches end under a stream of writes from several threads
+TEST(LsmDictionary, ConcurrentWriters)
+{
+    constexpr int NB_WRITERS = 2, NB_DOCS = 5000, WINDOW = 3; // Within MAX_RESULT_COUNT
+    Lsm_Dictionary dic(64);
+    std::atomic<int> running{NB_WRITERS};
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < NB_WRITERS; ++t)
+        writers.emplace_back([&, t] {
+            const char* text[] = {"alpha", "beta"};
+            for (int i = t * NB_DOCS; i < (t + 1) * NB_DOCS; ++i)
+            {
+                dic.insert(i, text);
+                if (i - WINDOW >= t * NB_DOCS)
+                    dic.remove(i - WINDOW);
+            }
+            running--;
+        });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; ++t)
+        readers.emplace_back([&] {
+            while (running > 0)
+                ASSERT_LE(dic.search("alpha").count(), NB_WRITERS * (WINDOW + 1));
+        });
+
+    for (auto& w : writers)
+        w.join();
+    for (auto& r : readers)
+        r.join();
+    ASSERT_EQ(dic.search("beta").count(), NB_WRITERS * WINDOW);
+}
+
+// Compared to DICTIONARY, the engine target is made of
+template <typename DICTIONARY>
+void check_adaptive(Adaptive_Dictionary::engine_t initial, Adaptive_Dictionary::engine_t target)
+{
+    Adaptive_Dictionary adaptive_dic(initial, std::chrono::milliseconds(0));
+    check_consistency<Adaptive_Dictionary, DICTIONARY>(adaptive_dic,
+                                                       [target](Adaptive_Dictionary& d) { d.migrate(target); });
+    ASSERT_EQ(adaptive_dic.engine(), target);
+}
+
+TEST(AdaptiveDictionary, Consistency)
+{
+    using engine_t = Adaptive_Dictionary::engine_t;
+    check_adaptive<Fusion_Dictionary>(engine_t::fusion, engine_t::fusion);
+    check_adaptive<hashmap_dictionary>(engine_t::fusion, engine_t::hashmap);
+    check_adaptive<Tree_Dictionary>(engine_t::hashmap, engine_t::tree);
+    check_adaptive<Fusion_Dictionary>(engine_t::tree, engine_t::fusion);
+}
+
+TEST(AdaptiveDictionary, Predict)
+{
+    using engine_t = Adaptive_Dictionary::engine_t;
+    Adaptive_Dictionary::stats_t window;
+    ASSERT_EQ(Adaptive_Dictionary::predict(window), engine_t::fusion);
+
+    window.searches = 1000;
+    window.inserts = 10;
+    window.removes = 10;
+    ASSERT_EQ(Adaptive_Dictionary::predict(window), engine_t::fusion);
+
+    window.inserts = 500;
+    window.vocabulary = 1000;
+    ASSERT_EQ(Adaptive_Dictionary::predict(window), engine_t::hashmap);
+    window.vocabulary = 100000;
+    ASSERT_EQ(Adaptive_Dictionary::predict(window), engine_t::tree);
+}
+
+// The engine changes after two windows of the same kind of workload
+TEST(AdaptiveDictionary, Adapt)
+{
+    using engine_t = Adaptive_Dictionary::engine_t;
+    Adaptive_Dictionary dic(engine_t::hashmap, std::chrono::milliseconds(0));
+    const char* text[] = {"alpha", "beta", "gamma"};
+    dic.insert(0, text);
+
+    const auto read = [&dic] {
+        for (std::uint64_t i = 0; i < Adaptive_Dictionary::MIN_WINDOW; ++i)
+            dic.search("alpha");
+    };
+    read();
+    ASSERT_FALSE(dic.adapt());
+    read();
+    ASSERT_TRUE(dic.adapt());
+    ASSERT_EQ(dic.engine(), engine_t::fusion);
+    ASSERT_EQ(dic.migrations(), 1);
+
+    const auto write = [&dic, &text] {
+        for (std::uint64_t i = 1; i <= Adaptive_Dictionary::MIN_WINDOW; ++i)
+        {
+            dic.insert(int(i), text);
+            dic.remove(int(i));
+        }
+    };
+    write();
+    ASSERT_FALSE(dic.adapt());
+    const Adaptive_Dictionary::stats_t s = dic.stats();
+    ASSERT_EQ(s.documents, 1u);
+    ASSERT_EQ(s.vocabulary, 3u);
+    ASSERT_EQ(s.words_per_document, 3.0);
+    write();
+    ASSERT_TRUE(dic.adapt());
+    ASSERT_EQ(dic.engine(), engine_t::hashmap);
+    ASSERT_EQ(dic.search("gamma").item(0).id(), 0);
+}
+
+// Migrations while a writer inserts and removes and readers search
+TEST(AdaptiveDictionary, OnlineMigration)
+{
+    using engine_t = Adaptive_Dictionary::engine_t;
+    Adaptive_Dictionary dic(engine_t::fusion, std::chrono::milliseconds(0));
+    std::atomic<bool> done{false};
+
+    std::thread writer([&] {
+        const char* text[] = {"alpha", "beta"};
+        for (int i = 0; i < 5000; ++i)
+        {
+            dic.insert(i, text);
+            if (i >= 5)
+                dic.remove(i - 5);
+        }
+        done = true;
+    });
+
+    std::thread reader([&] {
+        while (!done)
+        {
+            const result_t r = dic.search("alpha");
+            ASSERT_LE(r.count(), 6);
+        }
+    });
+
+    const engine_t engines[] = {engine_t::hashmap, engine_t::tree, engine_t::fusion};
+    for (int i = 0; !done; ++i)
+        dic.migrate(engines[i % 3]);
+
+    writer.join();
+    reader.join();
+    const result_t r = dic.search("beta");
+    ASSERT_EQ(r.count(), 5);
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(r.item(i).id(), 4995 + i);
+}
+
+TEST(Ring, Concurrent)
+{
+  constexpr int NB_THREADS = 4, NB_VALUES = 100000;
+  Ring<int> ring(64);
+  std::atomic<long> sum = 0;
+  std::atomic<int> popped = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NB_THREADS; ++t)
+  {
+    threads.emplace_back([&] {
+      for (int i = 1; i <= NB_VALUES; ++i)
+        while (!ring.try_push(i))
+          std::this_thread::yield();
+    });
+    threads.emplace_back([&] {
+      int v;
+      while (popped < NB_THREADS * NB_VALUES)
+        if (ring.try_pop(v))
+        {
+          sum += v;
+          ++popped;
+        }
+        else
+          std::this_thread::yield();
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  ASSERT_EQ(sum, long(NB_THREADS) * NB_VALUES * (NB_VALUES + 1) / 2);
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(TrieDictionary, QueuedConsistency)
+{
+  Scenario::param_t params;
+  params.word_count = 1000;
+  params.doc_count = 30;
+  params.word_redoundancy = 0.3f;
+  params.word_occupancy = 0.9f;
+  params.n_queries = 10000;
+  params.ratio_indel = 0.2;
+
+  Scenario scn(params);
+
+  Tree_Dictionary dic;
+  Queued_Dictionary<Tree_Dictionary> queued_dic;
+  scn.prepare(dic);
+  scn.prepare(queued_dic);
+  auto r1 = scn.execute(queued_dic, 1);
+  auto r2 = scn.execute(dic);
+  ASSERT_EQ(r1, r2);
+
+  // Searches only, many in flight
+  Queued_Dictionary<Tree_Dictionary> read_dic;
+  scn.prepare(read_dic);
+  Completion_Queue cq(64);
+  const auto words = scn.searches();
+  for (std::size_t i = 0; i < 64; ++i)
+  {
+    request_t r;
+    r.op   = request_t::search;
+    r.tag  = i;
+    r.cq   = &cq;
+    r.word = words[i];
+    ASSERT_TRUE(read_dic.submit(r));
+  }
+
+  std::vector<response_t> reaped(64);
+  std::size_t n = 0;
+  while (n < 64)
+    n += cq.wait(reaped.data() + n, 64 - n);
+  for (const auto& c : reaped)
+    ASSERT_EQ(c.result, read_dic.m_dic.search(words[c.tag]));
+}
+
+#if defined(__cpp_impl_coroutine)
+TEST(FusionDictionary, AwaitableConsistency)
+{
+  Scenario::param_t params;
+  params.word_count = 1000;
+  params.doc_count = 30;
+  params.word_redoundancy = 0.3f;
+  params.word_occupancy = 0.9f;
+  params.n_queries = 10000;
+  params.ratio_indel = 0.2;
+
+  Scenario scn(params);
+
+  Fusion_Dictionary dic;
+  Awaitable_Dictionary<Fusion_Dictionary> awaitable_dic;
+  scn.prepare(dic);
+  scn.prepare(awaitable_dic);
+  auto r1 = scn.execute(awaitable_dic, 1);
+  auto r2 = scn.execute(dic);
+  ASSERT_EQ(r1, r2);
+
+  // Many coroutines in flight, interleaving their writes
+  Awaitable_Dictionary<Fusion_Dictionary> many_dic;
+  scn.prepare(many_dic);
+  auto r3 = scn.execute(many_dic, 64);
+  ASSERT_EQ(r3.size(), r1.size());
+}
+
+static Task hold(std::shared_ptr<int>)
+{
+  co_return;
+}
+
+// The frame of a Task is freed with it if never spawned, by the scheduler otherwise
+TEST(Scheduler, TaskOwnership)
+{
+  auto p = std::make_shared<int>(0);
+  {
+    Task t = hold(p);
+    ASSERT_EQ(p.use_count(), 2);
+  }
+  ASSERT_EQ(p.use_count(), 1);
+
+  Scheduler scheduler;
+  {
+    Task t = hold(p);
+    Task moved = std::move(t);
+    scheduler.spawn(std::move(moved));
+  }
+  ASSERT_EQ(p.use_count(), 2);
+  scheduler.run();
+  ASSERT_EQ(p.use_count(), 1);
+}
+
+// Coroutines spawned beyond the capacity are refused instead of waiting for a free cell
+TEST(Scheduler, SpawnBeyondCapacity)
+{
+  auto p = std::make_shared<int>(0);
+  Scheduler scheduler(2);
+  ASSERT_TRUE(scheduler.spawn(hold(p)));
+  ASSERT_TRUE(scheduler.spawn(hold(p)));
+  ASSERT_FALSE(scheduler.spawn(hold(p)));
+  ASSERT_EQ(p.use_count(), 3);
+  scheduler.run();
+  ASSERT_EQ(p.use_count(), 1);
+}
+#endif
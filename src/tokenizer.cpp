@@ -0,0 +1,86 @@
+#include "tokenizer.hpp"
+
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+namespace
+{
+  // Push the words starting in the block at out, letters being the bits of its letters
+  // and prev_letter whether the byte before the block is a letter
+  void push_starts(char* out, std::uint32_t letters, bool prev_letter, std::vector<const char*>& words)
+  {
+    std::uint32_t starts = letters & ~((letters << 1) | std::uint32_t(prev_letter));
+    while (starts)
+    {
+      words.push_back(out + __builtin_ctz(starts));
+      starts &= starts - 1;
+    }
+  }
+
+#if defined(__AVX2__)
+  constexpr std::size_t BLOCK = 32;
+
+  // Lowercase the letters of the block at in into out, zero the other bytes
+  // and return the bits of the letters
+  std::uint32_t normalize_block(const char* in, char* out)
+  {
+    const __m256i v     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    // lower is a letter if lower - 'a' < 26 unsigned, i.e. lower - 'a' - 128 < 26 - 128 signed
+    const __m256i shifted = _mm256_sub_epi8(lower, _mm256_set1_epi8(char('a' + 128)));
+    const __m256i letter  = _mm256_cmpgt_epi8(_mm256_set1_epi8(char(26 - 128)), shifted);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_and_si256(lower, letter));
+    return std::uint32_t(_mm256_movemask_epi8(letter));
+  }
+#elif defined(__SSE2__)
+  constexpr std::size_t BLOCK = 16;
+
+  std::uint32_t normalize_block(const char* in, char* out)
+  {
+    const __m128i v       = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const __m128i lower   = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    const __m128i shifted = _mm_sub_epi8(lower, _mm_set1_epi8(char('a' + 128)));
+    const __m128i letter  = _mm_cmpgt_epi8(_mm_set1_epi8(char(26 - 128)), shifted);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_and_si128(lower, letter));
+    return std::uint32_t(_mm_movemask_epi8(letter));
+  }
+#endif
+}
+#endif
+
+void tokenize(std::string_view raw, std::vector<char>& buffer, std::vector<const char*>& words)
+{
+  const std::size_t n = raw.size();
+  buffer.resize(n + 1);
+  words.clear();
+
+  char*       out         = buffer.data();
+  std::size_t i           = 0;
+  bool        prev_letter = false;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; i + BLOCK <= n; i += BLOCK)
+  {
+    const std::uint32_t letters = normalize_block(raw.data() + i, out + i);
+    push_starts(out + i, letters, prev_letter, words);
+    prev_letter = (letters >> (BLOCK - 1)) & 1;
+  }
+#endif
+
+  // Tail, or all of raw without SIMD
+  for (; i < n; ++i)
+  {
+    const unsigned char lower  = static_cast<unsigned char>(raw[i]) | 0x20;
+    const bool          letter = unsigned(lower - 'a') < 26u;
+    out[i] = letter ? char(lower) : '\0';
+    if (letter && !prev_letter)
+      words.push_back(out + i);
+    prev_letter = letter;
+  }
+
+  out[n] = '\0';
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+/// Split raw text into the words of lowercase letters a-z that the dictionaries index
+/// ASCII letters are lowercased and any other byte separates two words.
+/// The words are written NUL-terminated into buffer, which the pointers of words point into,
+/// so both vectors can be reused from one text to the next without allocating.
+/// Blocks of 32 (AVX2) or 16 (SSE2) bytes are classified at once when available.
+void tokenize(std::string_view raw, std::vector<char>& buffer, std::vector<const char*>& words);
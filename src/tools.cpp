@@ -4,6 +4,7 @@
 #include <numeric>
 #include <random>
 #include <fstream>
+#include <thread>
 #include <spdlog/spdlog.h>
 
 
@@ -65,13 +66,13 @@ struct Scenario::scenario_impl_t
   std::vector<int>                      doc_ids;
   std::vector<std::vector<const char*>> texts;
   std::vector<query_t>                  queries;
+  std::vector<std::string>              typos;
   Scenario::param_t                     param;
 };
 
 
 namespace
 {
-  /*
   std::string word_modify(const std::string& s, std::mt19937& gen)
   {
     std::string res;
@@ -87,10 +88,10 @@ namespace
       else if (x < 0.85) // deletion
         pos++;
       else if (x < 0.9) // insertion
-        res.push_back((char) ('a' + 26 * ((x - 0.85) / 0.05)  ));
+        res.push_back((char) ('a' + std::min(25, int(26 * ((x - 0.85) / 0.05)))));
       else if (x < 0.95) // mutation
       {
-        res.push_back((char) ('a' + 26 * ((x - 0.9) / 0.05) ));
+        res.push_back((char) ('a' + std::min(25, int(26 * ((x - 0.9) / 0.05)))));
         pos++;
       }
       else if (pos + 1 < n) //
@@ -102,7 +103,6 @@ namespace
 
     return res;
   }
-  */
 
 }
 
@@ -184,17 +184,23 @@ namespace
       }
     }
 
-    // 3. Generate random ids for documents
+    // 3. Generate typo queries
+    std::vector<std::string> typos(p.n_typos);
+    for (auto& t : typos)
+      t = word_modify(k_word_full_list[word_gen(gen)], gen);
+
+    // 4. Generate random ids for documents
     std::vector<int> ids(texts.size());
     std::generate_n(ids.data(), ids.size(), [&gen, g = std::uniform_int_distribution()]() mutable { return g(gen); });
 
 
-    // 4. store the result
+    // 5. store the result
     dst->words      = k_word_full_list.data();
     dst->word_count = std::move(wc);
     dst->doc_ids    = std::move(ids);
     dst->texts      = std::move(texts);
     dst->queries    = std::move(queries);
+    dst->typos      = std::move(typos);
     dst->param      = p;
   }
 } // namespace
@@ -229,6 +235,7 @@ void Scenario::display_stats() const
   spdlog::info("\t\t searches={}  ({}% req={}%)", n_search, n_search / total * 100, 100 * (1 - r));
   spdlog::info("\t\t insertions={} ({}% req={}%)", n_insertion, n_insertion / total * 100, 100 * 0.5 * r);
   spdlog::info("\t\t deletions={} ({}% req={}%)", n_deletion, n_deletion / total * 100, 100 * 0.5 * r);
+  spdlog::info("\t Typo queries: {}", m_impl->typos.size());
  
 }
 
@@ -246,6 +253,157 @@ Scenario::Scenario(const param_t& params)
 }
 
 
+std::vector<result_t> Scenario::execute(IQueuedReversedDictionary& dic, int max_parallel_queries) const
+{
+  assert(max_parallel_queries > 0);
+
+  // The tag of a search is its rank, to store the results in the order of the queries
+  constexpr auto WRITE_TAG = ~std::uint64_t(0);
+  std::uint64_t n_searches = 0;
+  for (auto&& q : m_impl->queries)
+    n_searches += q.op == query_t::search;
+
+  std::vector<result_t>   results(n_searches);
+  Completion_Queue        cq(max_parallel_queries);
+  std::vector<response_t> reaped(cq.capacity());
+  int                     in_flight = 0;
+
+  auto complete = [&](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      if (reaped[i].tag != WRITE_TAG)
+        results[reaped[i].tag] = reaped[i].result;
+    in_flight -= int(n);
+  };
+
+  std::uint64_t search_rank = 0;
+  for (auto&& q : m_impl->queries)
+  {
+    if (in_flight == max_parallel_queries)
+      complete(cq.wait(reaped.data(), reaped.size()));
+
+    request_t r;
+    r.cq = &cq;
+    switch (q.op)
+    {
+    case query_t::search:
+      r.op   = request_t::search;
+      r.tag  = search_rank++;
+      r.word = m_impl->words[q.arg].c_str();
+      break;
+    case query_t::insert:
+      r.op          = request_t::insert;
+      r.tag         = WRITE_TAG;
+      r.document_id = m_impl->doc_ids[q.arg];
+      r.text        = m_impl->texts[q.arg];
+      break;
+    case query_t::erase:
+      r.op          = request_t::remove;
+      r.tag         = WRITE_TAG;
+      r.document_id = m_impl->doc_ids[q.arg];
+      break;
+    }
+
+    while (!dic.submit(r))
+    {
+      complete(cq.reap(reaped.data(), reaped.size()));
+      std::this_thread::yield();
+    }
+    ++in_flight;
+  }
+
+  while (in_flight > 0)
+    complete(cq.wait(reaped.data(), reaped.size()));
+  return results;
+}
+
+#if defined(__cpp_impl_coroutine)
+namespace
+{
+  // Await the queries first, first + step, ... of the scenario
+  Task replay(IAwaitableReversedDictionary& dic, Scenario::scenario_impl_t& impl,
+              const std::vector<std::size_t>& search_ranks, std::size_t first, std::size_t step,
+              std::vector<result_t>& results)
+  {
+    for (std::size_t i = first; i < impl.queries.size(); i += step)
+    {
+      const auto& q = impl.queries[i];
+      switch (q.op)
+      {
+      case query_t::search:
+        results[search_ranks[i]] = co_await dic.search(impl.words[q.arg].c_str());
+        break;
+      case query_t::insert:
+        co_await dic.insert(impl.doc_ids[q.arg], impl.texts[q.arg]);
+        break;
+      case query_t::erase:
+        co_await dic.remove(impl.doc_ids[q.arg]);
+        break;
+      }
+    }
+  }
+}
+
+std::vector<result_t> Scenario::execute(IAwaitableReversedDictionary& dic, int n_coroutines) const
+{
+  assert(n_coroutines > 0);
+
+  std::vector<std::size_t> search_ranks(m_impl->queries.size());
+  std::size_t n_searches = 0;
+  for (std::size_t i = 0; i < m_impl->queries.size(); ++i)
+    if (m_impl->queries[i].op == query_t::search)
+      search_ranks[i] = n_searches++;
+
+  std::vector<result_t> results(n_searches);
+  Scheduler scheduler;
+  for (int c = 0; c < n_coroutines; ++c)
+    scheduler.spawn(replay(dic, *m_impl, search_ranks, c, n_coroutines, results));
+  scheduler.run();
+  return results;
+}
+#endif
+
+std::vector<const char*> Scenario::searches() const
+{
+  std::vector<const char*> words;
+  for (auto&& q : m_impl->queries)
+    if (q.op == query_t::search)
+      words.push_back(m_impl->words[q.arg].c_str());
+  return words;
+}
+
+const std::vector<std::string>& Scenario::typos() const
+{
+  return m_impl->typos;
+}
+
+std::vector<std::string> Scenario::raw_texts() const
+{
+  const char* separators[] = {" ", " ", " ", " ", ", ", ". ", "\n", " - "};
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> rg(0, 7);
+
+  std::vector<std::string> texts;
+  for (auto&& text : m_impl->texts)
+  {
+    std::string raw;
+    bool capital = true; // At the start of a sentence
+    for (const char* word : text)
+    {
+      const auto pos = raw.size();
+      raw += word;
+      if (capital)
+        raw[pos] = char(raw[pos] - 'a' + 'A');
+
+      const int sep = rg(gen);
+      raw += separators[sep];
+      capital = separators[sep][0] == '.' || separators[sep][0] == '\n';
+    }
+    texts.push_back(std::move(raw));
+  }
+  return texts;
+}
+
 const Scenario::param_t& Scenario::params() const
 {
   return m_impl->param;
@@ -1,6 +1,7 @@
 #pragma once
 #include "IDictionary.hpp"
 #include "IAsyncDictionary.hpp"
+#include "IAwaitableDictionary.hpp"
 #include <string>
 #include <vector>
 #include <memory>
@@ -42,6 +43,12 @@ public:
        10% means: 1 doc insertion/deletion for 9 searches
      */
     float ratio_indel;
+
+    /* Number of typo queries
+     * Words picked randomly from 𝓛 and altered with insertions, deletions,
+     * mutations and transpositions, to be searched with a fuzzy search
+     */
+    std::size_t n_typos = 0;
   };
 
 
@@ -62,6 +69,24 @@ public:
                                 int max_parallel_read = 50,
                                 int max_parallel_write = 50) const;
 
+  // Execute a scenario with completion queues, with at most max_parallel_queries in flight
+  std::vector<result_t> execute(IQueuedReversedDictionary& dic, int max_parallel_queries = 256) const;
+
+#if defined(__cpp_impl_coroutine)
+  // Execute a scenario with n_coroutines on a Scheduler, each one awaiting its queries in turn
+  std::vector<result_t> execute(IAwaitableReversedDictionary& dic, int n_coroutines = 256) const;
+#endif
+
+  // Get the words of the search queries
+  std::vector<const char*> searches() const;
+
+  // Get the typo queries
+  const std::vector<std::string>& typos() const;
+
+  // Get the documents as raw text: words with some capitals,
+  // separated by spaces, punctuation and new lines
+  std::vector<std::string> raw_texts() const;
+
   // Get the scenario parameters
   const param_t& params() const;
 
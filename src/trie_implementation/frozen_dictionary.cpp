@@ -0,0 +1,101 @@
+#include "frozen_dictionary.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+Frozen_Dictionary::Frozen_Dictionary(const Node& root)
+    : units_{{0, -1, -1}}
+{
+    // Breadth-first so that siblings of consecutive states end up close in the array
+    std::queue<std::pair<const Node*, int>> queue;
+    queue.push({&root, 0});
+    std::size_t next_free = 1;
+
+    while (!queue.empty())
+    {
+        const auto [node, s] = queue.front();
+        queue.pop();
+
+        if (node->book_count() > 0)
+        {
+            units_[s].postings = int(postings_.size());
+            node->append_books(postings_);
+        }
+
+        // Only keep the subtrees still holding words
+        std::vector<std::pair<int, const Node*>> children;
+        for (char c = 'a'; c <= 'z'; ++c)
+        {
+            const Node* child = (*node)[c];
+            if (child != nullptr && child->best() > 0)
+                children.emplace_back(code(c), child);
+        }
+        if (children.empty())
+            continue;
+
+        // First base for which every child falls on a free unit
+        int base = std::max(0, int(next_free) - children.front().first);
+        for (;; ++base)
+        {
+            bool fits = true;
+            for (const auto& [c, child] : children)
+                if (std::size_t(base + c) < units_.size() && units_[base + c].check != -1)
+                {
+                    fits = false;
+                    break;
+                }
+            if (fits)
+                break;
+        }
+
+        units_[s].base = base;
+        units_.resize(std::max(units_.size(), std::size_t(base + children.back().first + 1)), unit{0, -1, -1});
+        for (const auto& [c, child] : children)
+        {
+            units_[base + c].check = s;
+            queue.push({child, base + c});
+        }
+
+        while (next_free < units_.size() && units_[next_free].check != -1)
+            ++next_free;
+    }
+
+    units_.shrink_to_fit();
+    postings_.shrink_to_fit();
+}
+
+gsl::span<const int> Frozen_Dictionary::books(const char* word) const
+{
+    if (units_.empty())
+        return {};
+
+    // Any byte is safe: a unit only passes the check for a real child of s
+    int s = 0;
+    for (; *word != '\0'; ++word)
+    {
+        const int t = units_[s].base + code(*word);
+        if (t < 0 || std::size_t(t) >= units_.size() || units_[t].check != s)
+            return {};
+        s = t;
+    }
+
+    const int offset = units_[s].postings;
+    if (offset < 0)
+        return {};
+    return gsl::make_span(postings_.data() + offset + 1, postings_[offset]);
+}
+
+result_t Frozen_Dictionary::search(const char* word) const
+{
+    result_t r;
+    const gsl::span<const int> b = books(word);
+    r.m_count = std::min(int(b.size()), MAX_RESULT_COUNT);
+    std::copy_n(b.begin(), r.m_count, r.m_matched);
+    return r;
+}
+
+std::size_t Frozen_Dictionary::memory_usage() const
+{
+    return units_.capacity() * sizeof(unit) + postings_.capacity() * sizeof(int);
+}
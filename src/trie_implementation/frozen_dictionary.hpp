@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "../IDictionary.hpp"
+#include "node.hpp"
+
+/// Immutable copy of a trie stored as a double-array trie
+/// The transition from state s with letter c goes to t = base[s] + code(c) if check[t] == s.
+/// Posting lists are stored one after the other in a single buffer.
+/// Nothing is locked nor modified after construction, so search can run from any thread.
+class Frozen_Dictionary
+{
+public:
+    Frozen_Dictionary() = default;
+    explicit Frozen_Dictionary(const Node& root);
+
+    result_t search(const char* word) const;
+
+    /// Every book of word, in insertion order, empty if the word is not there
+    gsl::span<const int> books(const char* word) const;
+
+    /// Heap size of the double array and the postings, in bytes
+    std::size_t memory_usage() const;
+
+private:
+    struct unit
+    {
+        int base;     // Children of this state are at base + code(letter)
+        int check;    // Parent state, -1 if the unit is free
+        int postings; // Offset of the posting list in postings_, -1 if no word ends here
+    };
+
+    static int code(char c)
+    {
+        return c - 'a' + 1;
+    }
+
+    std::vector<unit> units_;
+    std::vector<int>  postings_; // For each list: the number of books then the books
+};
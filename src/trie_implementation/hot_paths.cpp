@@ -0,0 +1,119 @@
+#include "hot_paths.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+    std::size_t hash(std::string_view word)
+    {
+        return std::hash<std::string_view>{}(word);
+    }
+} // namespace
+
+Hot_Paths::~Hot_Paths()
+{
+    while (pending_.load())
+        std::this_thread::yield();
+}
+
+const Node* Hot_Paths::search(const char* word, result_t& r) const
+{
+    const auto l = layout_.read();
+    if (!l)
+        return nullptr;
+
+    const std::size_t len = std::strlen(word);
+    if (len > slot::MAX_LENGTH)
+        return nullptr;
+
+    const std::size_t mask = l->slots.size() - 1;
+    for (std::size_t i = hash({word, len}) & mask;; i = (i + 1) & mask)
+    {
+        const slot& s = l->slots[i];
+        if (s.sub_node == nullptr)
+            return nullptr;
+        if (std::memcmp(s.word, word, len + 1) == 0)
+        {
+            s.sub_node->read_books(r);
+            return s.node;
+        }
+    }
+}
+
+void Hot_Paths::sample(const Node& root, const Node* node) const
+{
+    static std::atomic<unsigned> next{0};
+    thread_local const unsigned  stripe = next++ % N_STRIPES;
+
+    const unsigned n = stripes_[stripe].searches.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (n % SAMPLE_PERIOD != 0)
+        return;
+
+    node->add_heat();
+    if (n % (SAMPLE_PERIOD * RELAYOUT_PERIOD) != 0 || pending_.exchange(true))
+        return;
+
+    // The trie walk takes long, the searching thread goes on
+    arena_.enqueue([this, &root] {
+        relayout(root);
+        pending_.store(false);
+    });
+}
+
+void Hot_Paths::relayout(const Node& root) const
+{
+    // Only one relayout at a time, the others keep searching
+    std::unique_lock l(m_, std::try_to_lock);
+    if (!l.owns_lock())
+        return;
+
+    std::vector<std::pair<int, const Node*>> hot;
+    root.collect_heat(hot);
+
+    const std::size_t n = std::min(hot.size(), HOT_WORDS);
+    std::nth_element(hot.begin(), hot.begin() + n, hot.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::size_t size = 2;
+    while (size < 2 * n)
+        size *= 2;
+
+    auto table = std::make_shared<layout>();
+    table->slots.resize(size);
+    table->keep.reserve(n);
+
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        const Node* node = hot[k].second;
+        const auto  word = node->word();
+        auto        sub  = node->get_Sub_node();
+        if (word.size() > slot::MAX_LENGTH || sub == nullptr)
+            continue;
+
+        std::size_t i = hash(word) & (size - 1);
+        while (table->slots[i].sub_node != nullptr)
+            i = (i + 1) & (size - 1);
+
+        slot& s = table->slots[i];
+        std::memcpy(s.word, word.c_str(), word.size() + 1);
+        s.node     = node;
+        s.sub_node = sub.get();
+        table->keep.push_back(std::move(sub));
+    }
+
+    layout_.store(std::move(table));
+    l.unlock();
+    layout_.collect();
+}
+
+void Hot_Paths::clear()
+{
+    {
+        std::lock_guard l(m_);
+        layout_.store(nullptr);
+    }
+    layout_.collect();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <tbb/task_arena.h>
+
+#include "../IDictionary.hpp"
+#include "../epoch_ptr.hpp"
+#include "node.hpp"
+
+/// Contiguous copy of the paths of the most searched words of a trie
+///
+/// Searches are sampled into the heat of the trie nodes and, every few
+/// samples, the hottest words are copied into an open-addressing table of
+/// cache-line-sized slots holding the word and its Sub_node. A hot word is then
+/// found in one slot instead of one node per letter.
+///
+/// A new table replaces the current one without waiting for the readers, and
+/// the old one is freed once the searches started on it are done.
+/// The relayouts due to the sampling run on a worker of their own arena.
+class Hot_Paths
+{
+public:
+    Hot_Paths() = default;
+
+    /// Wait for the relayout started by sample(), if any
+    ~Hot_Paths();
+
+    static constexpr int         SAMPLE_PERIOD   = 64;      // Searches per sample, per stripe
+    static constexpr int         RELAYOUT_PERIOD = 1 << 14; // Samples per relayout, per stripe
+    static constexpr std::size_t HOT_WORDS       = 1024;    // Words kept in the table
+    static constexpr int         N_STRIPES       = 64;      // Search counters, threads beyond share them
+
+    /// Read the books of word in r and return its node if it is hot, nullptr otherwise
+    const Node* search(const char* word, result_t& r) const;
+
+    /// Sample a search that ended at node, starting a relayout of root from time to time
+    /// root must outlive this object
+    void sample(const Node& root, const Node* node) const;
+
+    /// Copy the hottest words of root into a new table
+    void relayout(const Node& root) const;
+
+    /// Drop the current table
+    void clear();
+
+private:
+    struct alignas(64) slot
+    {
+        static constexpr std::size_t MAX_LENGTH = 47;
+
+        char            word[MAX_LENGTH + 1];
+        const Node*     node     = nullptr; // To keep sampling hot words
+        const Sub_node* sub_node = nullptr; // nullptr if the slot is empty
+    };
+
+    struct layout
+    {
+        std::vector<slot>                      slots; // Size is a power of 2
+        std::vector<std::shared_ptr<Sub_node>> keep;  // Keep the Sub_nodes alive as long as the table
+    };
+
+    struct alignas(64) stripe_t
+    {
+        std::atomic<unsigned> searches{0};
+    };
+
+    mutable Epoch_Ptr<layout> layout_;  // Null if there is no table
+    mutable std::mutex        m_;       // To lock when relayouting
+    mutable stripe_t          stripes_[N_STRIPES];
+    mutable std::atomic<bool> pending_{false}; // A relayout is enqueued or running
+    mutable tbb::task_arena   arena_{1, 0};    // Runs the relayouts, initialized on the first one
+};
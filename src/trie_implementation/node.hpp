@@ -1,29 +1,45 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
 #include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <tbb/concurrent_hash_map.h>
+#include <tbb/parallel_for.h>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "../IDictionary.hpp"
 #include "sub_node.hpp"
+#include "sub_node_arena.hpp"
 #include "../hashmap_implementation/hashmap.hpp"
 
 static constexpr auto NB_LETTERS = 26;
 
+// A completed word with the documents containing it
+using completion_t = std::pair<std::string, result_t>;
+
 class Node
 {
 public:
-    using delete_map =
-        tbb::concurrent_hash_map<int, std::vector<std::shared_ptr<Sub_node>>>;
-    using delete_map_own = hashmap<int, std::vector<std::shared_ptr<Sub_node>>>;
+    using delete_map     = tbb::concurrent_hash_map<int, handle_span>;
+    using delete_map_own = hashmap<int, handle_span>;
 
     Node() = default;
 
-    explicit Node(char letter)
+    explicit Node(char letter, Node* parent = nullptr)
         : Sub_node_(nullptr)
         , letter_(letter)
+        , parent_(parent)
     {
         for (int i = 0; i < NB_LETTERS; ++i)
             children_[i] = nullptr;
@@ -31,23 +47,290 @@ public:
 
     void add_child(char letter)
     {
-        children_[letter - 'a'] = std::make_unique<Node>(letter);
+        children_[letter - 'a'] = std::make_unique<Node>(letter, this);
+    }
+
+    // Return the child of letter, creating it if it does not exist yet
+    Node* get_or_add_child(char letter)
+    {
+        Node* child = (*this)[letter];
+        if (child == nullptr)
+        {
+            // If 2 threads enters in the if at the same time, only one creates the child
+            std::lock_guard l(m);
+            child = (*this)[letter];
+            if (child == nullptr)
+            {
+                add_child(letter);
+                child = (*this)[letter];
+            }
+        }
+        return child;
+    }
+
+    // Sort the words of text by content and remove duplicates
+    static std::vector<const char*> sorted_words(gsl::span<const char*> text)
+    {
+        std::vector<const char*> words(text.begin(), text.end());
+        std::sort(words.begin(), words.end(),
+                  [](const char* a, const char* b) { return std::strcmp(a, b) < 0; });
+        words.erase(std::unique(words.begin(), words.end(),
+                                [](const char* a, const char* b) { return std::strcmp(a, b) == 0; }),
+                    words.end());
+        return words;
+    }
+
+    // Add book to each word of words (as returned by sorted_words) in one walk
+    // Each word starts from the deepest node it shares with the previous one
+    // on_word is called with the terminal node of each word and the word
+    template <typename F>
+    void add_words(const std::vector<const char*>& words, int book, F&& on_word)
+    {
+        _add_words<true>(words.begin(), words.end(), 0, book, on_word);
+    }
+
+    // Words of each book, as returned by sorted_words
+    using book_words_t = std::vector<std::pair<int, std::vector<const char*>>>;
+
+    // sorted_words of each book of d, sorted in parallel
+    static book_words_t sorted_books(const dictionary_t& d)
+    {
+        std::vector<std::pair<int, gsl::span<const char*>>> texts(d.begin(), d.end());
+        book_words_t books(texts.size());
+        tbb::parallel_for(std::size_t(0), texts.size(), [&](std::size_t k) {
+            books[k] = {texts[k].first, sorted_words(texts[k].second)};
+        });
+        return books;
+    }
+
+    // Add the words of books with one task per first letter, the subtrees of the
+    // children being independent. Nothing is locked, so no other thread may use
+    // the trie meanwhile. on_word is called as in add_words, from the tasks
+    template <typename F>
+    void build(const book_words_t& books, F&& on_word)
+    {
+        // Sorted by strcmp, so the words of a first letter are contiguous
+        const auto first_letter = [](const char* w) { return static_cast<unsigned char>(*w); };
+        const auto before       = [&](const char* w, unsigned char l) { return first_letter(w) < l; };
+        const auto after        = [&](unsigned char l, const char* w) { return l < first_letter(w); };
+
+        // First letters get their node here, the empty word (sorted first) ends here
+        for (const auto& [book, words] : books)
+            for (auto it = words.begin(); it != words.end();
+                 it = std::upper_bound(it, words.end(), first_letter(*it), after))
+            {
+                if (**it == '\0')
+                {
+                    _build_book(book);
+                    on_word(this, *it);
+                }
+                else if ((*this)[**it] == nullptr)
+                    add_child(**it);
+            }
+
+        tbb::parallel_for(0, NB_LETTERS, [&](int i) {
+            Node* child = children_[i].get();
+            if (child == nullptr)
+                return;
+
+            const unsigned char c = 'a' + i;
+            for (const auto& [book, words] : books)
+            {
+                const auto first = std::lower_bound(words.begin(), words.end(), c, before);
+                const auto last  = std::upper_bound(first, words.end(), c, after);
+                child->_add_words<false>(first, last, 1, book, on_word);
+            }
+            child->_init_best();
+        });
+
+        int n = book_count();
+        for (int i = 0; i < NB_LETTERS; ++i)
+            if (children_[i] != nullptr)
+                n = std::max(n, children_[i]->best());
+        best_.store(_summary(0, n), std::memory_order_relaxed);
+    }
+
+    // Largest number of books of a word in the subtree
+    int best() const
+    {
+        return _best(best_.load(std::memory_order_acquire));
+    }
+
+    // Raise best() from this node up to the root after its word got n books
+    // Stops at the first node that already has a better word below it. That node
+    // still gets a new version, so that a lower_best that read it before starts over
+    void raise_best(int n)
+    {
+        for (Node* node = this; node != nullptr; node = node->parent_)
+        {
+            std::uint64_t cur = node->best_.load(std::memory_order_relaxed);
+            while (!node->best_.compare_exchange_weak(cur, _summary(cur + VERSION, std::max(n, _best(cur))),
+                                                      std::memory_order_acq_rel, std::memory_order_relaxed))
+                continue;
+            if (_best(cur) >= n)
+                return;
+        }
+    }
+
+    // Recompute best() from this node up to the root after its word lost books
+    // Stops at the first node whose value does not change. The value is only
+    // stored if no raise_best went through the node since it was read
+    void lower_best()
+    {
+        for (Node* node = this; node != nullptr; node = node->parent_)
+        {
+            std::uint64_t cur = node->best_.load(std::memory_order_acquire);
+            int           n;
+            do
+            {
+                n = node->book_count();
+                for (int i = 0; i < NB_LETTERS; ++i)
+                    if (node->children_[i] != nullptr)
+                        n = std::max(n, node->children_[i]->best());
+                if (n == _best(cur))
+                    return;
+            } while (!node->best_.compare_exchange_strong(cur, _summary(cur + VERSION, n), std::memory_order_acq_rel,
+                                                          std::memory_order_acquire));
+        }
+    }
+
+    // Node reached by word from this one, nullptr if none
+    const Node* find(const char* word) const
+    {
+        const Node* cur = this;
+        while (cur != nullptr && *word != '\0')
+            cur = (*cur)[*word++];
+        return cur;
+    }
+
+    // Count a search that ended at this node in the heat of its path
+    void add_heat() const
+    {
+        for (const Node* n = this; n != nullptr; n = n->parent_)
+            n->heat_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Sampled number of searches that ended in the subtree
+    int heat() const
+    {
+        return heat_.load(std::memory_order_relaxed);
+    }
+
+    // Append to out the nodes of the subtree with their own heat, and halve
+    // the heat of the visited nodes so that old searches fade out
+    void collect_heat(std::vector<std::pair<int, const Node*>>& out) const
+    {
+        int own = heat();
+        for (int i = 0; i < NB_LETTERS; ++i)
+        {
+            const Node* child = children_[i].get();
+            if (child != nullptr && child->heat() > 0)
+            {
+                own -= child->heat();
+                child->collect_heat(out);
+            }
+        }
+
+        if (own > 0 && isSub_node())
+            out.emplace_back(own, this);
+        heat_.store(heat() / 2, std::memory_order_relaxed);
+    }
+
+    // Word spelled from the root to this node
+    std::string word() const
+    {
+        std::string w;
+        for (const Node* n = this; n->parent_ != nullptr; n = n->parent_)
+            w.push_back(n->letter_);
+        std::reverse(w.begin(), w.end());
+        return w;
+    }
+
+    // Append to out up to limit words of the subtree, most indexed first
+    // Subtrees are explored best-first by best(), so only the paths leading to
+    // the returned words are walked and empty subtrees are skipped
+    void top_words(int limit, std::vector<completion_t>& out) const
+    {
+        struct entry
+        {
+            int         score;
+            const Node* node;
+            bool        word; // node itself (true) or its subtree (false)
+
+            bool operator<(const entry& other) const
+            {
+                return score < other.score || (score == other.score && !word && other.word);
+            }
+        };
+
+        std::priority_queue<entry> queue;
+        if (best() > 0)
+            queue.push({best(), this, false});
+
+        while (!queue.empty() && int(out.size()) < limit)
+        {
+            const entry e = queue.top();
+            queue.pop();
+
+            if (e.word)
+            {
+                auto& [word, books] = out.emplace_back(e.node->word(), result_t{});
+                e.node->read_books(books);
+                continue;
+            }
+
+            if (const int n = e.node->book_count(); n > 0)
+                queue.push({n, e.node, true});
+            for (int i = 0; i < NB_LETTERS; ++i)
+            {
+                const Node* child = e.node->children_[i].get();
+                if (child != nullptr && child->best() > 0)
+                    queue.push({child->best(), child, false});
+            }
+        }
     }
 
     void add_book(int book)
     {
-        if (!is_Sub_node)
+        if (!isSub_node())
         {
-            Sub_node_ = std::make_shared<Sub_node>();
-            is_Sub_node = true;
+            // A word must keep a single Sub_node, which the indexes point to
+            std::lock_guard l(m);
+            if (!isSub_node())
+            {
+                Sub_node_ = std::make_shared<Sub_node>();
+                Sub_node_->owner = this;
+                is_Sub_node.store(true, std::memory_order_release);
+            }
         }
 
-        Sub_node_->insert(book);
+        raise_best(Sub_node_->insert(book));
+    }
+
+    // Append to out the words of the subtree within max_edits of word, with their distance
+    // The rows of the edit distance matrix are computed letter by letter while walking down
+    // (a Levenshtein automaton), and a subtree is pruned as soon as no cell of its row is
+    // within max_edits. A transposition of two adjacent letters counts as one edit.
+    void fuzzy_words(std::string_view word, int max_edits, std::vector<std::pair<int, const Node*>>& out) const
+    {
+        const int n = int(word.size());
+
+        // rows[d * (n + 1) + j] is the distance between word[0, j) and the d letters below this node
+        std::vector<int> rows(n + 1);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        if (rows[n] <= max_edits && book_count() > 0)
+            out.emplace_back(rows[n], this);
+
+        for (int i = 0; i < NB_LETTERS; ++i)
+            if (children_[i] != nullptr && children_[i]->best() > 0)
+                children_[i]->_fuzzy_words(word, max_edits, 1, rows, out);
     }
 
     void remove_book(int book)
     {
-        Sub_node_->erase(book);
+        if (Sub_node_->erase(book))
+            lower_best();
     }
 
     bool empty(void) const
@@ -60,6 +343,12 @@ public:
         return children_[c - 'a'].get();
     }
 
+    // Start loading the pointer to the child of letter c
+    void prefetch_child(char c) const
+    {
+        __builtin_prefetch(&children_[c - 'a']);
+    }
+
     Node* operator[](char c)
     {
         return children_[c - 'a'].get();
@@ -72,7 +361,7 @@ public:
 
     void read_books(result_t& r) const
     {
-        if (is_Sub_node)
+        if (isSub_node())
         {
             Sub_node_->read_books(r);
         } else
@@ -81,73 +370,255 @@ public:
         }
     }
 
+    // Sub_node_ is set before the flag, so it can be read once this returns true
     bool isSub_node(void) const
     {
-        return is_Sub_node;
+        return is_Sub_node.load(std::memory_order_acquire);
+    }
+
+    // Number of books of the word ending at this node
+    int book_count() const
+    {
+        return isSub_node() ? Sub_node_->size() : 0;
     }
 
-    void _init_Sub_nodes(delete_map_own& book_Sub_nodes)
+    // Append the number of books then the books of the word ending at this node to out
+    void append_books(std::vector<int>& out) const
     {
-        if (is_Sub_node)
+        if (isSub_node())
+            Sub_node_->append_books(out);
+        else
+            out.push_back(0);
+    }
+
+    // Approximate heap size of the subtree (nodes, Sub_nodes and their books) in bytes
+    std::size_t memory_usage() const
+    {
+        std::size_t n = sizeof(Node);
+        if (isSub_node())
+            n += sizeof(Sub_node) + Sub_node_->books.capacity() * sizeof(int);
+        for (int i = 0; i < NB_LETTERS; ++i)
+            if (children_[i] != nullptr)
+                n += children_[i]->memory_usage();
+        return n;
+    }
+
+    // Call on_book(book, handles) for each book of the trie with the handles of the
+    // Sub_nodes holding it. Subtrees are walked in parallel, and so are the books
+    template <typename F>
+    void for_each_book_handles(Sub_node_arena& arena, F&& on_book) const
+    {
+        std::vector<std::unordered_map<int, std::vector<std::uint32_t>>> parts(NB_LETTERS + 1);
+        tbb::parallel_for(0, NB_LETTERS, [&](int i) {
+            if (children_[i] != nullptr)
+                children_[i]->_init_Sub_nodes(parts[i], arena);
+        });
+        if (isSub_node())
         {
+            const std::uint32_t h = arena.handle(*Sub_node_);
             for (const int book : Sub_node_->books)
+                parts[NB_LETTERS][book].push_back(h);
+        }
+
+        std::vector<int> books;
+        std::unordered_set<int> seen;
+        for (const auto& part : parts)
+            for (const auto& [book, handles] : part)
+                if (seen.insert(book).second)
+                    books.push_back(book);
+
+        tbb::parallel_for(std::size_t(0), books.size(), [&](std::size_t k) {
+            std::vector<std::uint32_t> handles;
+            for (const auto& part : parts)
             {
-                auto node = book_Sub_nodes.find_node_locked(book);
-                if (node != nullptr)
-                {
-                    node->get_value()->emplace_back(Sub_node_);
-                    node->get_mutex().unlock();
-                }
-                else
-                {
-                    auto new_node = book_Sub_nodes.create_node(book);
-                    new_node->get_value()->emplace_back(Sub_node_);
-                    new_node->get_mutex().unlock();
-                }
+                const auto it = part.find(books[k]);
+                if (it != part.end())
+                    handles.insert(handles.end(), it->second.begin(), it->second.end());
             }
+            on_book(books[k], handles);
+        });
+    }
+
+    // Append the handle of each Sub_node of the subtree to the handles of its books
+    void _init_Sub_nodes(std::unordered_map<int, std::vector<std::uint32_t>>& book_handles,
+                         Sub_node_arena& arena) const
+    {
+        if (isSub_node())
+        {
+            const std::uint32_t h = arena.handle(*Sub_node_);
+            for (const int book : Sub_node_->books)
+                book_handles[book].push_back(h);
         }
 
         for (int i = 0; i < NB_LETTERS; ++i)
         {
             if (children_[i] != nullptr)
-                children_[i]->_init_Sub_nodes(book_Sub_nodes);
+                children_[i]->_init_Sub_nodes(book_handles, arena);
         }
     }
 
+    std::shared_ptr<Sub_node> get_Sub_node() const
+    {
+        return isSub_node() ? Sub_node_ : nullptr;
+    }
 
-    void _init_Sub_nodes(delete_map& book_Sub_nodes)
+    Sub_node* sub_node() const
     {
-        if (is_Sub_node)
+        return isSub_node() ? Sub_node_.get() : nullptr;
+    }
+
+    mutable std::mutex m; // To lock when adding a new word
+private:
+    // add_words from the node reached after the skip first letters of each word
+    // If Shared is false, the subtree is only used by the calling thread: nothing is
+    // locked and best() is left to _init_best
+    template <bool Shared, typename It, typename F>
+    void _add_words(It first, It last, std::size_t skip, int book, F& on_word)
+    {
+        // path[i] is the node reached after the i first letters of prev
+        std::vector<Node*> path{this};
+        const char* prev = "";
+
+        for (; first != last; ++first)
         {
-            for (const int book : Sub_node_->books)
+            const char* word = *first + skip;
+            std::size_t depth = 0;
+            while (depth + 1 < path.size() && word[depth] == prev[depth])
+                ++depth;
+            path.resize(depth + 1);
+
+            Node* cur = path.back();
+            for (const char* c = word + depth; *c != '\0'; ++c)
             {
-                delete_map::accessor a;
-                if (book_Sub_nodes.find(a, book))
-                    a->second.emplace_back(Sub_node_);
+                if (Shared)
+                    cur = cur->get_or_add_child(*c);
                 else
                 {
-                    book_Sub_nodes.insert(std::make_pair(
-                        book, std::vector<std::shared_ptr<Sub_node>>{Sub_node_}));
+                    if ((*cur)[*c] == nullptr)
+                        cur->add_child(*c);
+                    cur = (*cur)[*c];
                 }
+                path.push_back(cur);
             }
+
+            if (Shared)
+                cur->add_book(book);
+            else
+                cur->_build_book(book);
+            on_word(cur, *first);
+            prev = word;
         }
+    }
 
-        for (int i = 0; i < NB_LETTERS; ++i)
+    // add_book for a subtree only used by the calling thread
+    void _build_book(int book)
+    {
+        if (!isSub_node())
         {
-            if (children_[i] != nullptr)
-                children_[i]->_init_Sub_nodes(book_Sub_nodes);
+            Sub_node_ = std::make_shared<Sub_node>();
+            Sub_node_->owner = this;
+            is_Sub_node.store(true, std::memory_order_release);
         }
+        Sub_node_->books.push_back(book);
     }
 
-    std::shared_ptr<Sub_node> get_Sub_node()
+    // Set best() of the whole subtree from the books, bottom-up
+    int _init_best()
     {
-        return Sub_node_;
+        int n = isSub_node() ? int(Sub_node_->books.size()) : 0;
+        for (int i = 0; i < NB_LETTERS; ++i)
+            if (children_[i] != nullptr)
+                n = std::max(n, children_[i]->_init_best());
+        best_.store(_summary(0, n), std::memory_order_relaxed);
+        return n;
+    }
+
+    // best_ holds a version in its high half and best() in its low half
+    static constexpr std::uint64_t VERSION = std::uint64_t(1) << 32;
+
+    static int _best(std::uint64_t summary)
+    {
+        return int(std::uint32_t(summary));
+    }
+
+    static std::uint64_t _summary(std::uint64_t version, int best)
+    {
+        return (version & ~(VERSION - 1)) | std::uint32_t(best);
+    }
+
+    void _fuzzy_words(std::string_view word, int max_edits, int depth, std::vector<int>& rows,
+                      std::vector<std::pair<int, const Node*>>& out) const
+    {
+        const int n = int(word.size());
+        rows.resize((depth + 1) * (n + 1));
+
+        const int* prev2 = depth >= 2 ? &rows[(depth - 2) * (n + 1)] : nullptr;
+        const int* prev  = &rows[(depth - 1) * (n + 1)];
+        int*       row   = &rows[depth * (n + 1)];
+        const char prev_letter = depth >= 2 ? parent_->letter_ : '\0';
+
+        row[0]  = depth;
+        int min = row[0];
+        for (int j = 1; j <= n; ++j)
+        {
+            row[j] = std::min({prev[j] + 1, row[j - 1] + 1, prev[j - 1] + (word[j - 1] != letter_)});
+            if (prev2 && j >= 2 && letter_ == word[j - 2] && prev_letter == word[j - 1])
+                row[j] = std::min(row[j], prev2[j - 2] + 1);
+            min = std::min(min, row[j]);
+        }
+
+        if (row[n] <= max_edits && book_count() > 0)
+            out.emplace_back(row[n], this);
+
+        if (min > max_edits)
+            return;
+
+        for (int i = 0; i < NB_LETTERS; ++i)
+            if (children_[i] != nullptr && children_[i]->best() > 0)
+                children_[i]->_fuzzy_words(word, max_edits, depth + 1, rows, out);
     }
 
-    mutable std::mutex m; // To lock when adding a new word
-private:
     std::shared_ptr<Sub_node> Sub_node_; // Pointer to Sub_node if Sub_node
     char letter_; // Letter of node
     std::unique_ptr<Node> children_[NB_LETTERS]; // Array size 26 of pointer to child nodes
-    bool is_Sub_node = false; // To know if Sub_node
-};
\ No newline at end of file
+    std::atomic<bool> is_Sub_node{false}; // To know if Sub_node, set once Sub_node_ is
+    Node* parent_ = nullptr; // Parent node, nullptr for the root
+    std::atomic<std::uint64_t> best_{0}; // Version and largest number of books of a word in the subtree
+    mutable std::atomic<int> heat_{0}; // Sampled number of searches ended in the subtree
+};
+
+// Up to limit words of root starting with prefix, most indexed first
+inline std::vector<completion_t> prefix_completions(const Node& root, const char* prefix, int limit)
+{
+    std::vector<completion_t> r;
+    const Node* cur = root.find(prefix);
+    if (cur != nullptr)
+        cur->top_words(limit, r);
+    return r;
+}
+
+// Up to limit words of root within max_edits of word, closest first
+inline std::vector<completion_t> fuzzy_completions(const Node& root, const char* word, int max_edits, int limit)
+{
+    std::vector<std::pair<int, const Node*>> matches;
+    root.fuzzy_words(word, max_edits, matches);
+
+    // Closest words first, then the most indexed ones
+    std::vector<std::pair<std::pair<int, int>, const Node*>> ranked;
+    ranked.reserve(matches.size());
+    for (const auto& [dist, node] : matches)
+        ranked.push_back({{dist, -node->book_count()}, node});
+
+    limit = std::min(limit, int(ranked.size()));
+    std::partial_sort(ranked.begin(), ranked.begin() + limit, ranked.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<completion_t> r;
+    r.reserve(limit);
+    for (int i = 0; i < limit; ++i)
+    {
+        auto& [w, books] = r.emplace_back(ranked[i].second->word(), result_t{});
+        ranked[i].second->read_books(books);
+    }
+    return r;
+}
\ No newline at end of file
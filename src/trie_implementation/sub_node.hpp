@@ -3,31 +3,59 @@
 #include <vector>
 #include <shared_mutex>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "../IDictionary.hpp"
+
+class Node;
 
 struct Sub_node
 {
     // TODO with vector no risk of duplicate ?
     using book_set = std::vector<int>;
 
-    void insert(int book)
+    // Return the number of books after insertion
+    int insert(int book)
     {
         std::unique_lock l(m);
         books.emplace_back(book);
+        return int(books.size());
     }
 
-    void erase(int book)
+    // Return true if book was removed
+    bool erase(int book)
     {
         std::unique_lock l(m);
-        books.erase(std::remove(books.begin(), books.end(), book), books.end());
+        auto it = std::remove(books.begin(), books.end(), book);
+        const bool found = it != books.end();
+        books.erase(it, books.end());
+        return found;
+    }
+
+    int size() const
+    {
+        std::shared_lock l(m);
+        return int(books.size());
     }
 
-    void read_books(result_t& r)
+    void read_books(result_t& r) const
     {
         std::shared_lock l(m);
         r.m_count = std::min(int(books.size()), MAX_RESULT_COUNT);
         std::copy_n(books.begin(), r.m_count, r.m_matched);
     }
 
+    // Append the number of books then the books to out
+    void append_books(std::vector<int>& out) const
+    {
+        std::shared_lock l(m);
+        out.push_back(int(books.size()));
+        out.insert(out.end(), books.begin(), books.end());
+    }
+
     mutable std::shared_mutex m;
     book_set books;
+    Node* owner = nullptr; // Node of the word, to update the subtree summaries
+    std::atomic<std::uint32_t> handle{0}; // Handle in the Sub_node_arena of the dictionary, 0 if none
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "sub_node_arena.hpp"
+
+#include <algorithm>
+
+std::uint32_t Sub_node_arena::handle(Sub_node& s)
+{
+    std::uint32_t h = s.handle.load(std::memory_order_acquire);
+    if (h != 0)
+        return h;
+
+    // If 2 threads register s at the same time, the first one wins and the
+    // other slot is left unused
+    const auto          it   = sub_nodes_.push_back(&s);
+    const std::uint32_t mine = std::uint32_t(it - sub_nodes_.begin()) + 1;
+    if (s.handle.compare_exchange_strong(h, mine, std::memory_order_acq_rel))
+        return mine;
+    return h;
+}
+
+int Sub_node_arena::size_class(std::uint32_t n)
+{
+    int c = 0;
+    while ((MIN_CAPACITY << c) < n)
+        ++c;
+    return c;
+}
+
+handle_span Sub_node_arena::store(const std::vector<std::uint32_t>& handles)
+{
+    handle_span span;
+    if (handles.empty())
+        return span;
+
+    const int         c        = size_class(std::uint32_t(handles.size()));
+    const std::size_t capacity = std::size_t(MIN_CAPACITY) << c;
+    {
+        std::lock_guard l(m_);
+        if (!free_[c].empty())
+        {
+            span.data = free_[c].back();
+            free_[c].pop_back();
+        }
+        else if (capacity > CHUNK_SIZE / 4)
+        {
+            // Large arrays get a chunk of their own
+            chunks_.push_back(std::make_unique<std::uint32_t[]>(capacity));
+            span.data = chunks_.back().get();
+        }
+        else
+        {
+            if (used_ + capacity > CHUNK_SIZE)
+            {
+                chunks_.push_back(std::make_unique<std::uint32_t[]>(CHUNK_SIZE));
+                chunk_ = chunks_.back().get();
+                used_  = 0;
+            }
+            span.data = chunk_ + used_;
+            used_ += capacity;
+        }
+    }
+
+    span.size = std::uint32_t(handles.size());
+    std::copy(handles.begin(), handles.end(), span.data);
+    return span;
+}
+
+void Sub_node_arena::release(handle_span span)
+{
+    if (span.data == nullptr)
+        return;
+
+    std::lock_guard l(m_);
+    free_[size_class(span.size)].push_back(span.data);
+}
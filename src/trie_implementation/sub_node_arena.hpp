@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <tbb/concurrent_vector.h>
+#include <vector>
+
+#include "sub_node.hpp"
+
+/// Array of Sub_node handles allocated in a Sub_node_arena
+struct handle_span
+{
+    std::uint32_t* data = nullptr;
+    std::uint32_t  size = 0;
+
+    const std::uint32_t* begin() const
+    {
+        return data;
+    }
+
+    const std::uint32_t* end() const
+    {
+        return data + size;
+    }
+};
+
+/// Registry of Sub_nodes by 32-bit handle, and arena of the handle arrays
+///
+/// A document is indexed by an array of 4-byte handles instead of a vector of
+/// shared_ptr, so inserting and removing it touches no reference count.
+/// Sub_nodes are owned by their nodes, which live as long as the trie.
+class Sub_node_arena
+{
+public:
+    /// Handle of s, registering it on first use
+    std::uint32_t handle(Sub_node& s);
+
+    Sub_node& operator[](std::uint32_t h) const
+    {
+        return *sub_nodes_[h - 1];
+    }
+
+    /// Copy handles into an array of the arena
+    handle_span store(const std::vector<std::uint32_t>& handles);
+
+    /// Give the array of span back to the arena
+    void release(handle_span span);
+
+private:
+    static constexpr std::uint32_t MIN_CAPACITY = 4;       // Handles of the smallest array
+    static constexpr std::size_t   CHUNK_SIZE   = 1 << 16; // Handles per chunk
+    static constexpr int           NB_CLASSES   = 32;
+
+    // Smallest size class whose arrays hold n handles
+    static int size_class(std::uint32_t n);
+
+    tbb::concurrent_vector<Sub_node*> sub_nodes_; // Elements never move, handle h is at h - 1
+
+    std::mutex                                    m_; // To lock when allocating or releasing
+    std::vector<std::unique_ptr<std::uint32_t[]>> chunks_;
+    std::uint32_t*                                chunk_ = nullptr;    // Chunk small arrays are taken from
+    std::size_t                                   used_  = CHUNK_SIZE; // Handles used in chunk_
+    std::vector<std::uint32_t*>                   free_[NB_CLASSES];   // Released arrays by size class
+};
@@ -1,7 +1,7 @@
 #include "tree_dictionary.hpp"
 
 #include <algorithm>
-#include <unordered_set>
+#include <cstdint>
 
 #include "../IDictionary.hpp"
 
@@ -24,33 +24,16 @@ void Tree_Dictionary::init(const dictionary_t& d)
 
 void Tree_Dictionary::_init(const dictionary_t& d)
 {
-    for (const auto& [book, words] : d)
-        for (const auto& word : words)
-            _add_word(word, book);
-    root_._init_Sub_nodes(book_Sub_nodes_);
-}
-
-void Tree_Dictionary::_add_word(const char* word, int book,
-                                std::vector<std::shared_ptr<Sub_node>>& vect)
-{
-    Node* cur = &root_;
-    while (*word != '\0')
-    {
-        if ((*cur)[*word] == nullptr)
-        {
-            // If 2 threads enters in the if at the same time
-            // Can't use std::call_once cause this function maybe called
-            // multiple time
-            std::lock_guard(cur->m);
-            if ((*cur)[*word] == nullptr)
-                cur->add_child(*word);
-        }
-        cur = (*cur)[*word];
-        ++word;
-    }
-
-    cur->add_book(book);
-    vect.emplace_back(cur->get_Sub_node());
+    // Built in parallel without locks: init does not run along other operations
+    root_.build(Node::sorted_books(d), [](Node*, const char*) {});
+
+    root_.for_each_book_handles(arena_, [this](int book, const std::vector<std::uint32_t>& handles) {
+        // The handles of a book already indexed are all collected again
+        delete_map::accessor a;
+        if (!book_Sub_nodes_.insert(a, book))
+            arena_.release(a->second);
+        a->second = arena_.store(handles);
+    });
 }
 
 void Tree_Dictionary::_add_word(const char* word, const int book)
@@ -61,16 +44,7 @@ void Tree_Dictionary::_add_word(const char* word, const int book)
 
     while (*word != '\0')
     {
-        if ((*cur)[*word] == nullptr)
-        {
-            // If 2 threads enters in the if at the same time, thread-safe
-            // Can't use std::call_once cause this function maybe called
-            // multiple times
-            std::lock_guard(cur->m);
-            if ((*cur)[*word] == nullptr)
-                cur->add_child(*word);
-        }
-        cur = (*cur)[*word];
+        cur = cur->get_or_add_child(*word);
         ++word;
     }
 
@@ -79,19 +53,26 @@ void Tree_Dictionary::_add_word(const char* word, const int book)
 
 void Tree_Dictionary::_search_word(const char* word, result_t& r) const
 {
-    const Node* cur = &root_;
-    const int len = strlen(word);
-    for (int i = 0; i < len; ++i)
+    const Node* cur = hot_.search(word, r);
+    if (cur == nullptr)
     {
-        cur = (*cur)[word[i]];
-        if (cur == nullptr)
+        cur = &root_;
+        const int len = strlen(word);
+        for (int i = 0; i < len; ++i)
         {
-            r.m_count = 0;
-            return;
+            cur = (*cur)[word[i]];
+            if (cur == nullptr)
+            {
+                r.m_count = 0;
+                return;
+            }
         }
+
+        cur->read_books(r);
     }
 
-    cur->read_books(r);
+    if (cur->isSub_node())
+        hot_.sample(root_, cur);
 }
 
 result_t Tree_Dictionary::search(const char* word) const
@@ -101,37 +82,131 @@ result_t Tree_Dictionary::search(const char* word) const
     return r;
 }
 
-void Tree_Dictionary::insert(int document_id, gsl::span<const char*> text)
+prepared_t Tree_Dictionary::prepare(const char* word) const
 {
-    delete_map::accessor a;
-    if (!book_Sub_nodes_.find(a, document_id))
+    const Node* cur = &root_;
+    for (const char* c = word; cur != nullptr && *c != '\0'; ++c)
+        cur = (*cur)[*c];
+
+    // The Sub_node of a word lives as long as the trie, even once its books are removed
+    if (cur == nullptr || !cur->isSub_node())
+        return {word, nullptr, 0};
+    return {word, cur->get_Sub_node(), id_.value};
+}
+
+result_t Tree_Dictionary::search_prepared(const prepared_t& q) const
+{
+    if (q.owner != id_.value)
+        return search(q.word.c_str());
+
+    result_t r;
+    static_cast<const Sub_node*>(q.location.get())->read_books(r);
+    return r;
+}
+
+void Tree_Dictionary::search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const
+{
+    // The walks of BATCH words go down one letter each in turn: the child a walk
+    // needs next is prefetched, and loaded while the other walks go on
+    constexpr std::size_t BATCH = 16;
+    struct walk_t
     {
-        auto s = std::unordered_set<const char*>();
-        for (const char* word : text)
-            s.emplace(word);
+        const char* next; // Letters left
+        const Node* cur;
+        std::size_t i;    // Index of the word
+    };
+    walk_t walks[BATCH];
 
-        // Add new entry to hahsmap and fill it below (_add_word)
-        book_Sub_nodes_.insert(
-            a, std::make_pair(document_id, std::vector<std::shared_ptr<Sub_node>>{}));
+    for (std::size_t first = 0; first < words.size(); first += BATCH)
+    {
+        std::size_t active = std::min(BATCH, words.size() - first);
+        for (std::size_t k = 0; k < active; ++k)
+        {
+            walks[k] = {words[first + k], &root_, first + k};
+            if (*walks[k].next != '\0')
+                root_.prefetch_child(*walks[k].next);
+        }
 
-        for (const char* word : s)
+        while (active > 0)
         {
-            _add_word(word, document_id, a->second);
+            for (std::size_t k = 0; k < active;)
+            {
+                walk_t& w = walks[k];
+                if (w.cur == nullptr || *w.next == '\0')
+                {
+                    if (w.cur == nullptr)
+                        out[w.i].m_count = 0;
+                    else
+                    {
+                        w.cur->read_books(out[w.i]);
+                        if (w.cur->isSub_node())
+                            hot_.sample(root_, w.cur);
+                    }
+                    w = walks[--active];
+                    continue;
+                }
+
+                w.cur = (*w.cur)[*w.next++];
+                if (w.cur != nullptr && *w.next != '\0')
+                    w.cur->prefetch_child(*w.next);
+                ++k;
+            }
         }
     }
 }
 
+std::vector<completion_t> Tree_Dictionary::search_prefix(const char* prefix, int limit) const
+{
+    return prefix_completions(root_, prefix, limit);
+}
+
+std::vector<completion_t> Tree_Dictionary::search_fuzzy(const char* word, int max_edits, int limit) const
+{
+    return fuzzy_completions(root_, word, max_edits, limit);
+}
+
+void Tree_Dictionary::relayout()
+{
+    hot_.relayout(root_);
+}
+
+Frozen_Dictionary Tree_Dictionary::freeze() const
+{
+    return Frozen_Dictionary(root_);
+}
+
+void Tree_Dictionary::insert(int document_id, gsl::span<const char*> text)
+{
+    // The accessor holds the new entry until it is filled below (add_words):
+    // a concurrent insert of the same document waits, then finds it there
+    delete_map::accessor a;
+    if (book_Sub_nodes_.insert(a, document_id))
+    {
+        const auto words = Node::sorted_words(text);
+
+        std::vector<std::uint32_t> handles;
+        handles.reserve(words.size());
+        root_.add_words(words, document_id, [&](Node* n, const char*) {
+            handles.push_back(arena_.handle(*n->sub_node()));
+        });
+        a->second = arena_.store(handles);
+    }
+}
+
 void Tree_Dictionary::_remove(int document_id)
 {
     delete_map::accessor a;
     if (book_Sub_nodes_.find(a, document_id))
     {
-        // For each entry in out vector, delete book instance in the Sub_node vector
-        for (size_t i = 0; i < a->second.size(); ++i)
+        // For each handle of the document, delete book instance in the Sub_node vector
+        for (const std::uint32_t h : a->second)
         {
-            a->second[i]->erase(document_id);
+            Sub_node& sn = arena_[h];
+            if (sn.erase(document_id))
+                sn.owner->lower_best();
         }
         // Delete entry from the hashmap
+        arena_.release(a->second);
         book_Sub_nodes_.erase(a);
     }
 }
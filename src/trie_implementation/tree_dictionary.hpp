@@ -8,13 +8,15 @@
 #include <vector>
 
 #include "../IDictionary.hpp"
+#include "frozen_dictionary.hpp"
+#include "hot_paths.hpp"
 #include "node.hpp"
+#include "sub_node_arena.hpp"
 
 class Tree_Dictionary : public IReversedDictionary
 {
 public:
-    using delete_map =
-        tbb::concurrent_hash_map<int, std::vector<std::shared_ptr<Sub_node>>>;
+    using delete_map = Node::delete_map;
     Tree_Dictionary();
     Tree_Dictionary(const dictionary_t& init);
 
@@ -26,18 +28,41 @@ public:
 
     virtual void init(const dictionary_t& d) final;
     virtual result_t search(const char* word) const final;
+    virtual void     search_batch(gsl::span<const char* const> words, gsl::span<result_t> out) const final;
+    virtual prepared_t prepare(const char* word) const final;
+    virtual result_t   search_prepared(const prepared_t& q) const final;
     virtual void insert(int document_id, gsl::span<const char*> text) final;
     virtual void remove(int document_id) final;
+
+    /// Search the words starting with \p prefix, the most indexed first,
+    /// with the documents containing them
+    std::vector<completion_t> search_prefix(const char* prefix,
+                                            int limit = MAX_RESULT_COUNT) const;
+
+    /// Search the words within \p max_edits insertions, deletions, substitutions
+    /// or transpositions of \p word, the closest first, with the documents containing them
+    std::vector<completion_t> search_fuzzy(const char* word, int max_edits,
+                                           int limit = MAX_RESULT_COUNT) const;
+
+    /// Immutable copy of the current index for lock-free read-only serving
+    Frozen_Dictionary freeze() const;
+
+    /// Copy the paths of the most searched words into contiguous storage
+    /// Also done automatically every Hot_Paths::RELAYOUT_PERIOD sampled searches
+    void relayout();
+
     void _add_word(const char* word, int book);
-    void _add_word(const char* word, int book,
-                   std::vector<std::shared_ptr<Sub_node>>& vect);
 
     // TODO private
     Node root_;
+    Sub_node_arena arena_; // Sub_node handles and the handle arrays of book_Sub_nodes_
     delete_map book_Sub_nodes_;
 
 private:
     void _init(const dictionary_t& d);
     void _search_word(const char* word, result_t& r) const;
     void _remove(int document_id);
+
+    Hot_Paths     hot_; // After root_, so that its relayouts end before root_ is destroyed
+    instance_id_t id_;  // Owner of the prepared_t resolved here
 };
\ No newline at end of file